@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+
+/**
+ * Compares beam decoding with the regular node pool (whole nodes) and with
+ *    the structure-of-arrays node pool, reporting run time and cache misses.
+ *
+ * Usage: NodePoolBenchmark [beamWidth [numPackets]]
+ *
+ * Cache misses are read from Linux hardware performance counters. Where
+ *    these are not available (e.g. in some virtual machines), only times
+ *    are reported.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "codes/spinal/CodeFactory.h"
+#include "mappers/LinearMapper.h"
+#include "channels/AwgnChannel.h"
+#include "util/MTRand.h"
+
+/**
+ * A hardware performance counter of the calling thread
+ */
+class PerfCounter {
+public:
+	PerfCounter(uint32_t type, uint64_t config) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		m_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+
+	~PerfCounter() {
+		if(m_fd >= 0) {
+			close(m_fd);
+		}
+	}
+
+	bool valid() { return m_fd >= 0; }
+
+	void start() {
+		if(m_fd >= 0) {
+			ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+
+	uint64_t stop() {
+		uint64_t count = 0;
+		if(m_fd >= 0) {
+			ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+			if(read(m_fd, &count, sizeof(count)) != sizeof(count)) {
+				count = 0;
+			}
+		}
+		return count;
+	}
+
+private:
+	int m_fd;
+};
+
+/**
+ * Decodes the same packets with the given decoder, and prints statistics
+ */
+static void runDecoder(const char* name,
+					   IHashDecoder<Symbol>::Ptr decoder,
+					   const std::vector<std::string>& packets,
+					   const std::vector< std::vector<Symbol> >& received,
+					   const std::vector<uint16_t>& spineIndices)
+{
+	PerfCounter l1Misses(PERF_TYPE_HW_CACHE,
+						 PERF_COUNT_HW_CACHE_L1D
+						 | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+						 | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	PerfCounter llcMisses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+	unsigned int numCorrect = 0;
+
+	clock_t start = clock();
+	l1Misses.start();
+	llcMisses.start();
+	for(unsigned int i = 0; i < packets.size(); i++) {
+		decoder->reset();
+		decoder->add(spineIndices, received[i], 1.0);
+		numCorrect += (decoder->decode().packet == packets[i]);
+	}
+	uint64_t numL1Misses = l1Misses.stop();
+	uint64_t numLlcMisses = llcMisses.stop();
+	double seconds = double(clock() - start) / CLOCKS_PER_SEC;
+
+	printf("%-8s %8.2f ms/packet  %u/%u correct",
+		   name,
+		   1000.0 * seconds / packets.size(),
+		   numCorrect,
+		   (unsigned int)packets.size());
+	if(l1Misses.valid()) {
+		printf("  L1D read misses/packet %llu",
+			   (unsigned long long)(numL1Misses / packets.size()));
+	}
+	if(llcMisses.valid()) {
+		printf("  cache misses/packet %llu",
+			   (unsigned long long)(numLlcMisses / packets.size()));
+	}
+	if(!l1Misses.valid() && !llcMisses.valid()) {
+		printf("  (performance counters unavailable)");
+	}
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	const unsigned int k = 4;
+	const unsigned int c = 10;
+	const unsigned int precisionBits = 16;
+	const unsigned int packetLength = 256;
+	const unsigned int spineLength = packetLength / k;
+	const unsigned int numPasses = 2;
+
+	unsigned int beamWidth = (argc > 1) ? atoi(argv[1]) : 1024;
+	unsigned int numPackets = (argc > 2) ? atoi(argv[2]) : 10;
+
+	CodeFactory codeFactory(k, spineLength);
+	IEncoderFactoryPtr encoderFactory = codeFactory.salsa();
+	ISymbolSearchFactoryPtr searchFactory =
+			encoderFactory->linear(c, precisionBits);
+
+	LinearMapper mapper(c, precisionBits);
+	SymbolAwgnChannel channel(mapper.getAveragePower() / 100.0);
+	MTRand random(1u);
+
+	// Every spine value is transmitted numPasses times
+	std::vector<uint16_t> spineIndices;
+	for(unsigned int pass = 0; pass < numPasses; pass++) {
+		for(unsigned int i = 0; i < spineLength; i++) {
+			spineIndices.push_back(i);
+		}
+	}
+
+	// Generate all packets and received symbols in advance
+	std::vector<std::string> packets(numPackets);
+	std::vector< std::vector<Symbol> > received(numPackets);
+	for(unsigned int i = 0; i < numPackets; i++) {
+		packets[i].resize(packetLength / 8);
+		for(unsigned int j = 0; j < packets[i].size(); j++) {
+			packets[i][j] = (char)random.randInt(255);
+		}
+
+		IMultiStreamEncoder::Ptr encoder = encoderFactory->encoder();
+		encoder->setPacket(packets[i]);
+
+		std::vector<uint16_t> encoded;
+		std::vector<Symbol> mapped;
+		encoder->encode(spineIndices, encoded);
+		mapper.process(encoded, mapped);
+		channel.process(mapped, received[i]);
+	}
+
+	printf("k=%u c=%u B=%u, %u bit packets\n",
+		   k, c, beamWidth, packetLength);
+
+	runDecoder("AoS",
+			   searchFactory->beamDecoder(1, beamWidth, numPasses, numPasses),
+			   packets, received, spineIndices);
+	runDecoder("SoA",
+			   searchFactory->soaBeamDecoder(1, beamWidth, numPasses, numPasses),
+			   packets, received, spineIndices);
+
+	return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+
+/**
+ * Measures spinal encoding and decoding speed over a matrix of code and
+ *    decoder parameters: k, c, beam width, spine length, hash function and
+ *    search type.
+ *
+ * Usage: SpinalBenchmark [numPackets [numPasses]]
+ *
+ * Results are written to stdout as CSV, one line per configuration, with
+ *    these columns:
+ *    k, c, beamWidth, spineLength, hash, search: the configuration
+ *    encodeSymbolsPerSec: HashEncoder throughput, with encode()
+ *    encodePassesSymbolsPerSec: HashEncoder throughput, with encodePasses()
+ *    decodeP50Ms, decodeP90Ms, decodeP99Ms: HashDecoder::decode() latency
+ *        percentiles, in milliseconds
+ *    nodesPerSec: tree nodes expanded per second of decoding
+ *    numCorrect, numPackets: how many packets were decoded correctly
+ *
+ * The lookahead search uses lookahead depth 1 and a beam of
+ *    beamWidth / 2^k, so it expands as many nodes per spine value as the
+ *    beam search.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <time.h>
+
+#include "codes/spinal/CodeFactory.h"
+#include "mappers/LinearMapper.h"
+#include "channels/AwgnChannel.h"
+#include "util/MTRand.h"
+
+// Signal to noise ratio of the channel, in dB
+static const double SNR_DB = 10.0;
+
+// Number of passes encoded when measuring encoder throughput
+static const unsigned int NUM_ENCODE_PASSES = 64;
+
+// Number of bits the channel's "ADC" resolves
+static const unsigned int PRECISION_BITS = 16;
+
+/**
+ * One benchmarked configuration
+ */
+struct Config {
+	unsigned int k;
+	unsigned int c;
+	unsigned int beamWidth;
+	unsigned int spineLength;
+	const char* hash;
+	const char* search;
+};
+
+/**
+ * @return a monotonic time, in seconds
+ */
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/**
+ * @return the p'th percentile (0 <= p <= 1) of sorted values
+ */
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	unsigned int ind = (unsigned int)(p * (sorted.size() - 1) + 0.5);
+	return sorted[ind];
+}
+
+/**
+ * @return the encoder factory for the configuration's hash function
+ */
+static IEncoderFactoryPtr encoderFactory(const Config& config)
+{
+	CodeFactory codeFactory(config.k, config.spineLength);
+	std::string hash(config.hash);
+
+	if(hash == "salsa") {
+		return codeFactory.salsa();
+	} else if(hash == "lookup3") {
+		return codeFactory.lookup3();
+	} else {
+		return codeFactory.oneAtATime();
+	}
+}
+
+/**
+ * @return the lookahead search's beam width, for a configuration
+ */
+static unsigned int lookaheadBeamWidth(const Config& config)
+{
+	return std::max(1u, config.beamWidth >> config.k);
+}
+
+/**
+ * @return the decoder for the configuration
+ */
+static IHashDecoder<Symbol>::Ptr decoder(const Config& config,
+										 unsigned int numPasses)
+{
+	ISymbolSearchFactoryPtr searchFactory =
+			encoderFactory(config)->linear(config.c, PRECISION_BITS);
+
+	if(std::string(config.search) == "lookahead") {
+		return searchFactory->lookaheadBeamDecoder(lookaheadBeamWidth(config),
+												   1,
+												   numPasses,
+												   numPasses);
+	}
+	return searchFactory->beamDecoder(1,
+									  config.beamWidth,
+									  numPasses,
+									  numPasses);
+}
+
+/**
+ * @return the number of tree nodes a decoder expands to decode a packet
+ */
+static double nodesPerDecode(const Config& config)
+{
+	bool lookahead = (std::string(config.search) == "lookahead");
+	unsigned int beamWidth = lookahead ? lookaheadBeamWidth(config)
+									   : config.beamWidth;
+	// A lookahead node holds 2^k tree nodes, all of which are branched
+	double nodesPerChild = lookahead ? (1 << config.k) : 1;
+
+	double numNodes = 0;
+	double beamSize = 1;
+	for(unsigned int i = 0; i < config.spineLength; i++) {
+		numNodes += beamSize * (1 << config.k) * nodesPerChild;
+		beamSize = std::min(beamSize * (1 << config.k), double(beamWidth));
+	}
+	return numNodes;
+}
+
+/**
+ * Benchmarks one configuration, and prints its CSV line
+ */
+static void run(const Config& config,
+				unsigned int numPackets,
+				unsigned int numPasses)
+{
+	const unsigned int packetLength = config.k * config.spineLength;
+
+	IEncoderFactoryPtr factory = encoderFactory(config);
+	IHashDecoder<Symbol>::Ptr dec = decoder(config, numPasses);
+
+	LinearMapper mapper(config.c, PRECISION_BITS);
+	double n0 = mapper.getAveragePower() / pow(10.0, SNR_DB / 10.0);
+	SymbolAwgnChannel channel(n0);
+	MTRand random(1u);
+
+	std::vector<uint16_t> decodeIndices;
+	for(unsigned int pass = 0; pass < numPasses; pass++) {
+		for(unsigned int i = 0; i < config.spineLength; i++) {
+			decodeIndices.push_back(i);
+		}
+	}
+
+	std::vector<uint16_t> encodeIndices;
+	for(unsigned int pass = 0; pass < NUM_ENCODE_PASSES; pass++) {
+		for(unsigned int i = 0; i < config.spineLength; i++) {
+			encodeIndices.push_back(i);
+		}
+	}
+
+	double encodeSeconds = 0;
+	double encodePassesSeconds = 0;
+	std::vector<double> decodeSeconds;
+	unsigned int numCorrect = 0;
+
+	std::vector<uint16_t> encoded;
+	std::vector<Symbol> mapped;
+	std::vector<Symbol> received;
+
+	for(unsigned int i = 0; i < numPackets; i++) {
+		std::string packet((packetLength + 7) / 8, 0);
+		for(unsigned int j = 0; j < packet.size(); j++) {
+			packet[j] = (char)random.randInt(255);
+		}
+
+		// Encoder throughput
+		IMultiStreamEncoder::Ptr encoder = factory->encoder();
+		double start = now();
+		encoder->setPacket(packet);
+		encoder->encode(encodeIndices, encoded);
+		encodeSeconds += now() - start;
+
+		start = now();
+		encoder->setPacket(packet);
+		encoder->encodePasses(NUM_ENCODE_PASSES, encoded);
+		encodePassesSeconds += now() - start;
+
+		// Symbols to decode
+		encoder->setPacket(packet);
+		encoder->encode(decodeIndices, encoded);
+		mapper.process(encoded, mapped);
+		channel.process(mapped, received);
+
+		// Decode latency
+		start = now();
+		dec->reset();
+		dec->add(decodeIndices, received, n0);
+		DecodeResult result = dec->decode();
+		decodeSeconds.push_back(now() - start);
+
+		numCorrect += (result.packet == packet);
+	}
+
+	std::sort(decodeSeconds.begin(), decodeSeconds.end());
+	double totalDecodeSeconds = 0;
+	for(unsigned int i = 0; i < decodeSeconds.size(); i++) {
+		totalDecodeSeconds += decodeSeconds[i];
+	}
+
+	printf("%u,%u,%u,%u,%s,%s,%.0f,%.0f,%.4f,%.4f,%.4f,%.0f,%u,%u\n",
+		   config.k,
+		   config.c,
+		   config.beamWidth,
+		   config.spineLength,
+		   config.hash,
+		   config.search,
+		   double(numPackets) * encodeIndices.size() / encodeSeconds,
+		   double(numPackets) * encodeIndices.size() / encodePassesSeconds,
+		   1000.0 * percentile(decodeSeconds, 0.5),
+		   1000.0 * percentile(decodeSeconds, 0.9),
+		   1000.0 * percentile(decodeSeconds, 0.99),
+		   numPackets * nodesPerDecode(config) / totalDecodeSeconds,
+		   numCorrect,
+		   numPackets);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int numPackets = (argc > 1) ? atoi(argv[1]) : 20;
+	unsigned int numPasses = (argc > 2) ? atoi(argv[2]) : 4;
+
+	const unsigned int ks[] = {3, 4};
+	const unsigned int cs[] = {6, 10};
+	const unsigned int beamWidths[] = {16, 64, 256};
+	const unsigned int spineLengths[] = {32, 128};
+	const char* hashes[] = {"salsa", "lookup3", "oneAtATime"};
+	const char* searches[] = {"beam", "lookahead"};
+
+	printf("k,c,beamWidth,spineLength,hash,search,encodeSymbolsPerSec,"
+		   "encodePassesSymbolsPerSec,"
+		   "decodeP50Ms,decodeP90Ms,decodeP99Ms,nodesPerSec,"
+		   "numCorrect,numPackets\n");
+
+	for(unsigned int ik = 0; ik < sizeof(ks) / sizeof(ks[0]); ik++)
+	for(unsigned int ic = 0; ic < sizeof(cs) / sizeof(cs[0]); ic++)
+	for(unsigned int ib = 0; ib < sizeof(beamWidths) / sizeof(beamWidths[0]); ib++)
+	for(unsigned int il = 0; il < sizeof(spineLengths) / sizeof(spineLengths[0]); il++)
+	for(unsigned int ih = 0; ih < sizeof(hashes) / sizeof(hashes[0]); ih++)
+	for(unsigned int is = 0; is < sizeof(searches) / sizeof(searches[0]); is++) {
+		Config config = {ks[ik],
+						 cs[ic],
+						 beamWidths[ib],
+						 spineLengths[il],
+						 hashes[ih],
+						 searches[is]};
+		run(config, numPackets, numPasses);
+	}
+
+	return 0;
+}
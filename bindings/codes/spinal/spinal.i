@@ -49,6 +49,10 @@
 %shared_ptr(IHashDecoder<ComplexSymbol>)
 %shared_ptr(ISearchFactory<FadingSymbol>)
 %shared_ptr(IHashDecoder<FadingSymbol>)
+%shared_ptr(IStreamingHashDecoder<Symbol>)
+%shared_ptr(IStreamingHashDecoder<SoftSymbol>)
+%shared_ptr(IStreamingHashDecoder<FadingSymbol>)
+%shared_ptr(IStreamingDecodeCallback)
 %shared_ptr(StubHashDecoder)
 
 
@@ -76,6 +80,7 @@
 #include "codes/spinal/HashEncoder.h"
 #include "codes/spinal/HashDecoder.h"
 #include "codes/spinal/IHashDecoder.h"
+#include "codes/spinal/IStreamingHashDecoder.h"
 
 #include "codes/spinal/protocols/StridedProtocol.h"
 
@@ -89,6 +94,7 @@
 %include "codes/spinal/HashEncoder.h"
 %include "codes/spinal/HashDecoder.h"
 %include "codes/spinal/IHashDecoder.h"
+%include "codes/spinal/IStreamingHashDecoder.h"
 %include "codes/spinal/protocols/StridedProtocol.h"
 %include "codes/spinal/Composites.h"
 %include "codes/spinal/StubHashDecoder.h"
@@ -107,6 +113,12 @@ namespace std {
 %template(template_IHashDecoder_Fading) IHashDecoder<FadingSymbol>;
 %template(template_ISearchFactory_Fading) ISearchFactory<FadingSymbol>; 
 
+// Streaming decoders. Without directors, Python code gets committed blocks
+// with takeBlocks() rather than a callback.
+%template(template_IStreamingHashDecoder_Symbol) IStreamingHashDecoder<Symbol>;
+%template(template_IStreamingHashDecoder_SoftSymbol) IStreamingHashDecoder<SoftSymbol>;
+%template(template_IStreamingHashDecoder_Fading) IStreamingHashDecoder<FadingSymbol>;
+
 
 // Symbol storage
 %template(SymbolFlatSymbolStorage) FlatSymbolStorage<Symbol>;
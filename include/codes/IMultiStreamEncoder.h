@@ -44,4 +44,16 @@ public:
 	virtual void encode(
 			const std::vector<uint16_t>& streamIndices,
 			std::vector<uint16_t>& outSymbols) = 0;
+
+	/**
+	 * Encodes whole passes, where a pass has one value from each stream.
+	 *     Equivalent to calling encode() 'numPasses' times, each time with
+	 *     all streams in order.
+	 * @param numPasses: the number of passes to encode
+	 * @param outSymbols: [out] where symbols will be written. The value of
+	 *     stream i in pass p is at index (p * numStreams + i).
+	 */
+	virtual void encodePasses(
+			unsigned int numPasses,
+			std::vector<uint16_t>& outSymbols) = 0;
 };
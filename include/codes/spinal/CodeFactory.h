@@ -10,6 +10,7 @@
 #include "../IDecoder.h"
 #include "../IMultiStreamEncoder.h"
 #include "IHashDecoder.h"
+#include "IStreamingHashDecoder.h"
 
 // Forward declarations
 class IEncoderFactory;
@@ -21,6 +22,28 @@ typedef std::tr1::shared_ptr<ISearchFactory<Symbol> > ISymbolSearchFactoryPtr;
 typedef std::tr1::shared_ptr<ISearchFactory<SoftSymbol > > ISoftSearchFactoryPtr;
 typedef std::tr1::shared_ptr<ISearchFactory<FadingSymbol > > IFadingSearchFactoryPtr;
 
+/**
+ * \ingroup spinal
+ * \brief The type of path weights (metrics) that decoders keep
+ *
+ * The narrow metrics are renormalized after every spine value, by subtracting
+ *    the best weight in the beam. Their weights are therefore relative, and
+ *    decoders using them do not support early termination.
+ */
+enum SpinalMetric {
+	// 64-bit integers for integer symbols, doubles for soft symbols
+	METRIC_DEFAULT,
+
+	// Saturating 32-bit integers. Squared distances are scaled to 24 bits.
+	METRIC_UINT32,
+
+	// Saturating 16-bit integers. Squared distances are scaled to 16 bits.
+	METRIC_UINT16,
+
+	// Single precision floats
+	METRIC_FLOAT
+};
+
 /**
  * \ingroup spinal
  * \brief Main factory for spinal encoders and decoders
@@ -34,6 +57,19 @@ public:
 	IEncoderFactoryPtr lookup3();
 	IEncoderFactoryPtr oneAtATime();
 
+	/**
+	 * Codes whose symbols are bit-packed out of the hash state: each state
+	 *     gives (state bits / symbolBits) symbols instead of 32 (salsa) or 2
+	 *     (lookup3), so far fewer hashes are computed when encoding and
+	 *     decoding. These are different codes than salsa() and lookup3().
+	 *
+	 * @param symbolBits: the number of bits in each symbol, 6 or 8. Mappers
+	 *     must use at most symbolBits bits of each symbol (e.g. a linear
+	 *     mapper with c <= symbolBits).
+	 */
+	IEncoderFactoryPtr packedSalsa(unsigned int symbolBits);
+	IEncoderFactoryPtr packedLookup3(unsigned int symbolBits);
+
 private:
 	unsigned int m_k;
 	unsigned int m_spineLength;
@@ -48,9 +84,16 @@ public:
 	virtual ~IEncoderFactory() {}
 	virtual IMultiStreamEncoder::Ptr encoder() = 0;
 
+	/**
+	 * The integer metrics need distance tables, i.e. premapperNumBits of at
+	 *     most 10. All metrics except METRIC_UINT32 and METRIC_UINT16 can be
+	 *     used with soft().
+	 */
 	virtual ISymbolSearchFactoryPtr linear(unsigned int premapperNumBits,
-										   unsigned int precisionBits) = 0;
-	virtual ISoftSearchFactoryPtr soft(unsigned int premapperNumBits) = 0;
+										   unsigned int precisionBits,
+										   SpinalMetric metric = METRIC_DEFAULT) = 0;
+	virtual ISoftSearchFactoryPtr soft(unsigned int premapperNumBits,
+									   SpinalMetric metric = METRIC_DEFAULT) = 0;
 	virtual ISymbolSearchFactoryPtr gaussian(unsigned int premapperNumBits,
 											 unsigned int precisionBits,
 											 float numStandardDevs) = 0;
@@ -67,6 +110,8 @@ class ISearchFactory {
 public:
 	typedef std::tr1::shared_ptr<ISearchFactory<ChannelSymbol> > Ptr;
 	typedef std::tr1::shared_ptr<IHashDecoder<ChannelSymbol> > IHashDecoderPtr;
+	typedef std::tr1::shared_ptr<IStreamingHashDecoder<ChannelSymbol> >
+		IStreamingHashDecoderPtr;
 
 	virtual ~ISearchFactory() {};
 	virtual IHashDecoderPtr beamDecoder(
@@ -79,5 +124,55 @@ public:
 			unsigned int lookaheadDepth,
 			unsigned int maxNumSymbolsPerValue,
 			unsigned int maxNumSymbolsLastValue) = 0;
+
+	/**
+	 * Makes a beam decoder whose node pool keeps weights, seeds and other
+	 *     node fields in separate arrays (see SoADualPool). The decoder gives
+	 *     the same results as beamDecoder()
+	 */
+	virtual IHashDecoderPtr soaBeamDecoder(
+			unsigned int numLists,
+			unsigned int numBestPerList,
+			unsigned int maxNumSymbolsPerValue,
+			unsigned int maxNumSymbolsLastValue) = 0;
+
+	/**
+	 * Makes a beam decoder that branches the beam on several threads. The
+	 *     decoder gives the same results as beamDecoder(1, beamWidth, ...)
+	 */
+	virtual IHashDecoderPtr threadedBeamDecoder(
+			unsigned int beamWidth,
+			unsigned int numThreads,
+			unsigned int maxNumSymbolsPerValue,
+			unsigned int maxNumSymbolsLastValue) = 0;
+
+	/**
+	 * Makes a best-first sequential decoder (see StackSearch). At high SNR it
+	 *     branches far fewer nodes than a beam decoder.
+	 *
+	 * @param maxNumNodes: the number of nodes the decoder makes before it
+	 *     continues greedily
+	 * @param bias: how much to favor deeper paths. 1 compares paths by how
+	 *     far their weight is from the noise energy expected on the correct
+	 *     path; larger values branch fewer nodes.
+	 *
+	 * @note only supports the default metric
+	 */
+	virtual IHashDecoderPtr stackDecoder(
+			unsigned int maxNumNodes,
+			double bias,
+			unsigned int maxNumSymbolsPerValue,
+			unsigned int maxNumSymbolsLastValue) = 0;
+
+	/**
+	 * Makes a streaming beam decoder (see IStreamingHashDecoder), that
+	 *     commits a spine value's message bits once the search is
+	 *     'commitDistance' spine values past it.
+	 */
+	virtual IStreamingHashDecoderPtr streamingDecoder(
+			unsigned int beamWidth,
+			unsigned int commitDistance,
+			unsigned int maxNumSymbolsPerValue,
+			unsigned int maxNumSymbolsLastValue) = 0;
 };
 
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+template<typename Mapper, typename Distance> class DistanceTableStorage;
+
+/**
+ * \ingroup spinal
+ * \brief The distance tables of the symbols of one spine value
+ */
+template<typename Weight>
+struct DistanceTableCollection {
+	// C'tor
+	DistanceTableCollection(const Weight* _tables, unsigned int _size)
+	   : tables(_tables), size(_size) {}
+
+	// C'tor, from the tables stored for a spine value
+	template<typename Mapper, typename Distance>
+	DistanceTableCollection(DistanceTableStorage<Mapper, Distance>& storage,
+							unsigned int spineValueInd)
+	   : tables(storage.tables(spineValueInd)),
+		 size(storage.size(spineValueInd)) {}
+
+	// The tables, one after the other. See DistanceTableStorage::tables()
+	const Weight* tables;
+
+	// The number of tables (i.e., symbols) in the collection
+	unsigned int size;
+};
+
+/**
+ * \ingroup spinal
+ * \brief Stores, for every received symbol, its distance to every symbol the
+ *     mapper can output.
+ *
+ * When the mapper's input has few bits, there are few possible candidate
+ *     symbols, so the distance from a received symbol to each of them is
+ *     computed once, when the symbol is added. Branch evaluation then only
+ *     needs to look the distance up using the encoded symbol.
+ *
+ * Tables grow as symbols are added, and keep their memory when the storage is
+ *     reset, so they are only allocated while decoding the first packets.
+ */
+template<typename Mapper, typename Distance>
+class DistanceTableStorage {
+public:
+	typedef typename Mapper::OutputType ChannelSymbol;
+	typedef typename Distance::Weight Weight;
+
+	/**
+	 * C'tor
+	 * @param spineLength: the number of spine values to store symbols for
+	 * @param mapper: the mapper that produces candidate symbols
+	 * @param numInputBits: the number of bits of the mapper's input that
+	 * 		affect its output
+	 * @param distance: the distance between symbols
+	 */
+	DistanceTableStorage(unsigned int spineLength,
+						 const Mapper& mapper,
+						 unsigned int numInputBits,
+						 const Distance& distance = Distance());
+
+	/**
+	 * Erases all symbols from the storage, preparing it for a new message
+	 */
+	void reset();
+
+	/**
+	 * Adds the symbol to the spine value, computing its distance table. The
+	 * 		order of the tables is the same as the order passed to add().
+	 */
+	void add(unsigned int spineValueInd,
+			 ChannelSymbol sym);
+
+	/**
+	 * @return a pointer to the distance tables for a specific spine value.
+	 * 		Entry (i * tableSize() + x) is the distance between symbol i and
+	 * 		the mapper's output for input x.
+	 * @param spineValueInd: the spine value to return tables for
+	 */
+	const Weight* tables(unsigned int spineValueInd);
+
+	/**
+	 * @return the number of symbols in storage, for a specific spine value
+	 * @param spineValueInd: the spine value to return symbols for
+	 */
+	unsigned int size(unsigned int spineValueInd);
+
+	/**
+	 * @return the number of entries in each table
+	 */
+	unsigned int tableSize();
+
+private:
+	// number of spine values
+	const unsigned int m_spineLength;
+
+	// The number of entries in each table, 2^numInputBits
+	const unsigned int m_tableSize;
+
+	// The distance between symbols
+	Distance m_distance;
+
+	// The mapper's output for each input
+	std::vector<ChannelSymbol> m_candidates;
+
+	// The tables of each spine value. Only grow.
+	std::vector< std::vector<Weight> > m_tables;
+
+	// The number of symbols currently in storage, for each spine value
+	std::vector<uint16_t> m_numSymbols;
+};
+
+
+#include "DistanceTableStorage.hh"
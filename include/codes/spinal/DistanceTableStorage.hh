@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#include <stddef.h>
+#include <algorithm>
+#include <stdexcept>
+
+template<typename Mapper, typename Distance>
+inline DistanceTableStorage<Mapper, Distance>::DistanceTableStorage(
+		unsigned int spineLength,
+		const Mapper& mapper,
+		unsigned int numInputBits,
+		const Distance& distance)
+  : m_spineLength(spineLength),
+    m_tableSize(1 << numInputBits),
+    m_distance(distance),
+    m_candidates(m_tableSize),
+    m_tables(spineLength),
+    m_numSymbols(spineLength, 0)
+{
+	// Make sure the spine is non-empty
+	if(spineLength < 1) {
+		throw(std::runtime_error("Spine length has to be positive"));
+	}
+
+	// The candidate symbols do not change, so they are mapped only once
+	Mapper localMapper(mapper);
+	for(unsigned int x = 0; x < m_tableSize; x++) {
+		m_candidates[x] = localMapper.map(x);
+	}
+}
+
+template<typename Mapper, typename Distance>
+inline void DistanceTableStorage<Mapper, Distance>::reset() {
+	// Tables are kept allocated, to be overwritten by the next message
+	std::fill(m_numSymbols.begin(), m_numSymbols.end(), 0);
+}
+
+template<typename Mapper, typename Distance>
+inline void DistanceTableStorage<Mapper, Distance>::add(
+		unsigned int spineValueInd,
+		ChannelSymbol sym)
+{
+	std::vector<Weight>& tables = m_tables[spineValueInd];
+	unsigned int tableBase = m_numSymbols[spineValueInd] * m_tableSize;
+
+	if(tables.size() < tableBase + m_tableSize) {
+		tables.resize(tableBase + m_tableSize);
+	}
+
+	Weight* table = &tables[tableBase];
+	const ChannelSymbol* candidates = &m_candidates[0];
+	for(unsigned int x = 0; x < m_tableSize; x++) {
+		table[x] = m_distance.dist(sym, candidates[x]);
+	}
+
+	m_numSymbols[spineValueInd]++;
+}
+
+template<typename Mapper, typename Distance>
+inline const typename DistanceTableStorage<Mapper, Distance>::Weight *
+DistanceTableStorage<Mapper, Distance>::tables(unsigned int spineValueInd)
+{
+	if(m_tables[spineValueInd].empty()) {
+		return NULL;
+	}
+	return &m_tables[spineValueInd][0];
+}
+
+template<typename Mapper, typename Distance>
+inline unsigned int DistanceTableStorage<Mapper, Distance>::size(
+		unsigned int spineValueInd)
+{
+	return m_numSymbols[spineValueInd];
+}
+
+template<typename Mapper, typename Distance>
+inline unsigned int DistanceTableStorage<Mapper, Distance>::tableSize()
+{
+	return m_tableSize;
+}
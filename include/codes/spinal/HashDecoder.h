@@ -38,6 +38,8 @@ public:
 	typedef typename Search::Node Node;
 	typedef typename Search::Weight Weight;
 	typedef typename Search::Evaluator::ChannelSymbol ChannelSymbol;
+	typedef typename Search::Evaluator::SymbolStorage SymbolStorage;
+	typedef typename Search::BranchData BranchData;
 
 	/**
 	 * C'tor
@@ -94,6 +96,46 @@ public:
 	 */
 	virtual SpinalDecodeResult decodeExtended();
 
+	/**
+	 * Enables or disables incremental decoding. In incremental mode the
+	 *   search keeps a copy of the beam at every spine value, and decode()
+	 *   only re-expands spine values from the lowest one that received new
+	 *   symbols since the last decode().
+	 */
+	virtual void setIncremental(bool incremental);
+
+	/**
+	 * Enables or disables abandoning decode attempts that are likely to fail
+	 *   (see IHashDecoder::setEarlyTermination)
+	 */
+	virtual void setEarlyTermination(float numStdDevs);
+
+	/**
+	 * @return true if the last decode attempt was abandoned early
+	 */
+	virtual bool isAbandoned();
+
+	/**
+	 * Enables or disables the spine value cache
+	 *   (see IHashDecoder::setSpineValueCache)
+	 */
+	virtual void setSpineValueCache(unsigned int numEntries);
+
+	/**
+	 * @return the number of spine values found in the cache
+	 */
+	virtual uint64_t spineValueCacheHits();
+
+	/**
+	 * @return the number of spine values that were not in the cache
+	 */
+	virtual uint64_t spineValueCacheMisses();
+
+	/**
+	 * Limits backtracking memory (see IHashDecoder::setTracebackWindow)
+	 */
+	virtual void setTracebackWindow(unsigned int numLayers);
+
 	///////////////////////////////////////////////////////////////////
 	//// Fine-grained control of the decode process
 	///////////////////////////////////////////////////////////////////
@@ -140,6 +182,32 @@ public:
 	double getDetectionMetric();
 
 private:
+	/**
+	 * Runs the search over all spine values, resuming from a previous search
+	 *   if the decoder is incremental.
+	 */
+	void searchSpine();
+
+	/**
+	 * @return true if the best path is too heavy for the correct path to be
+	 *   in the beam, given the noise energy expected up to the current spine
+	 *   value.
+	 *
+	 * @param expectedEnergy: the expected noise energy of the correct path
+	 * @param energyVariance: the variance of that energy
+	 */
+	bool isHopeless(double expectedEnergy, double energyVariance);
+
+	// Selects whether the search uses expected weights, at compile time
+	template<bool value> struct BoolTag {};
+
+	/**
+	 * Tells the search the noise energy expected on the correct path in a
+	 *   spine value, if the search uses it (see UsesExpectedWeights)
+	 */
+	void setExpectedStepWeight(unsigned int spineIndex, BoolTag<true>);
+	void setExpectedStepWeight(unsigned int spineIndex, BoolTag<false>) {}
+
 	/**
 	 * Compares the two Nodes. Helper function to allow sorting of the result
 	 *     of getBeamNodes by weight.
@@ -155,11 +223,31 @@ private:
 	// The number of coding steps
 	const unsigned int m_spineLength;
 
-	// Symbol organizer
-	FlatSymbolStorage<ChannelSymbol> m_storage;
-
 	// Instance to perform beam search
 	Search m_search;
+
+	// Symbol organizer, made by the search's branch evaluator
+	SymbolStorage m_storage;
+
+	// True if decode() should resume the previous search
+	bool m_incremental;
+
+	// The lowest spine value that received symbols since the last search
+	unsigned int m_firstDirtySpineIndex;
+
+	// Threshold for early termination, in standard deviations. 0 if disabled
+	float m_earlyTerminationStdDevs;
+
+	// True if the last search stopped before the end of the spine
+	bool m_abandoned;
+
+	// The expected noise energy of the symbols of each spine value, and its
+	// variance
+	std::vector<double> m_noiseEnergy;
+	std::vector<double> m_noiseEnergyVariance;
+
+	// Buffer for the best path when checking for early termination
+	std::vector<unsigned short> m_bestPath;
 };
 
 // include implementation
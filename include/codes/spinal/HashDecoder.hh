@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <stdexcept>
 #include <cstdlib> // for rand()
+#include <math.h> // for sqrt()
 
 #include "../../util/Utils.h"
 #include <iostream>
@@ -25,10 +26,17 @@ HashDecoder<Search>::HashDecoder(
 		const Search& search)
 	: m_k(k),
 	  m_spineLength(spineLength),
-	  m_storage(spineLength,
+	  m_search(search),
+	  m_storage(m_search.branchEvaluator().symbolStorage(
+			  	spineLength,
 			  	maxNumSymbolsPerValue,
-			  	maxNumSymbolsLastValue),
-	  m_search(search)
+			  	maxNumSymbolsLastValue)),
+	  m_incremental(false),
+	  m_firstDirtySpineIndex(0),
+	  m_earlyTerminationStdDevs(0),
+	  m_abandoned(false),
+	  m_noiseEnergy(spineLength, 0.0),
+	  m_noiseEnergyVariance(spineLength, 0.0)
 {}
 
 
@@ -36,6 +44,15 @@ template<typename Search>
 inline void HashDecoder<Search>::reset()
 {
 	m_storage.reset();
+
+	// The cache is shared by the decode attempts of one packet
+	m_search.branchEvaluator().spineValueCache().clear();
+
+	// None of the previous search is valid for the new packet
+	m_firstDirtySpineIndex = 0;
+
+	std::fill(m_noiseEnergy.begin(), m_noiseEnergy.end(), 0.0);
+	std::fill(m_noiseEnergyVariance.begin(), m_noiseEnergyVariance.end(), 0.0);
 }
 
 
@@ -45,14 +62,22 @@ inline void HashDecoder<Search>::add(
 		const std::vector<ChannelSymbol> & symbols,
 		N0_t n0)
 {
-	// channel noise not used in this type of computation
-	(void)n0;
+	// Channel noise is only used to decide on early termination. The noise of
+	// a real symbol has variance n0/2, so its energy has mean n0/2 and
+	// variance 2 * (n0/2)^2
+	double noiseVariance = n0 / 2.0;
 
 	unsigned int numSymbols = spineValueIndices.size();
 
 	// Add symbols to storage
 	for(unsigned int i = 0; i < numSymbols; i++) {
 		m_storage.add(spineValueIndices[i], symbols[i]);
+		m_firstDirtySpineIndex = std::min(m_firstDirtySpineIndex,
+										  (unsigned int)spineValueIndices[i]);
+
+		m_noiseEnergy[spineValueIndices[i]] += noiseVariance;
+		m_noiseEnergyVariance[spineValueIndices[i]] +=
+				2 * noiseVariance * noiseVariance;
 	}
 }
 
@@ -61,11 +86,7 @@ inline void HashDecoder<Search>::add(
 template<typename Search>
 inline DecodeResult HashDecoder<Search>::decode()
 {
-	initializeSearch();
-
-	for (unsigned int spineIndex = 0; spineIndex < m_spineLength; spineIndex++) {
-		doInference(spineIndex);
-	}
+	searchSpine();
 
 	DecodeResult result;
 	getMostLikelyResult(result);
@@ -75,11 +96,7 @@ inline DecodeResult HashDecoder<Search>::decode()
 template<typename Search>
 inline SpinalDecodeResult HashDecoder<Search>::decodeExtended()
 {
-	initializeSearch();
-
-	for (unsigned int spineIndex = 0; spineIndex < m_spineLength; spineIndex++) {
-		doInference(spineIndex);
-	}
+	searchSpine();
 
 	SpinalDecodeResult result;
 	getMostLikelyResult(result);
@@ -88,6 +105,127 @@ inline SpinalDecodeResult HashDecoder<Search>::decodeExtended()
 }
 
 
+template<typename Search>
+inline void HashDecoder<Search>::setIncremental(bool incremental)
+{
+	m_incremental = incremental;
+	m_search.setCheckpointing(incremental);
+
+	// Checkpoints were not kept before, so the next search starts afresh
+	m_firstDirtySpineIndex = 0;
+}
+
+template<typename Search>
+inline void HashDecoder<Search>::setEarlyTermination(float numStdDevs)
+{
+	m_earlyTerminationStdDevs = numStdDevs;
+}
+
+template<typename Search>
+inline bool HashDecoder<Search>::isAbandoned()
+{
+	return m_abandoned;
+}
+
+template<typename Search>
+inline void HashDecoder<Search>::setSpineValueCache(unsigned int numEntries)
+{
+	m_search.branchEvaluator().spineValueCache().resize(numEntries);
+}
+
+template<typename Search>
+inline uint64_t HashDecoder<Search>::spineValueCacheHits()
+{
+	return m_search.branchEvaluator().spineValueCache().numHits();
+}
+
+template<typename Search>
+inline uint64_t HashDecoder<Search>::spineValueCacheMisses()
+{
+	return m_search.branchEvaluator().spineValueCache().numMisses();
+}
+
+template<typename Search>
+inline void HashDecoder<Search>::setTracebackWindow(unsigned int numLayers)
+{
+	m_search.setTracebackWindow(numLayers);
+}
+
+template<typename Search>
+inline void HashDecoder<Search>::searchSpine()
+{
+	unsigned int firstSpineIndex = 0;
+	if(m_incremental) {
+		// The search state up to the first modified spine value is still
+		// valid; the search might choose to rewind to an earlier spine value
+		firstSpineIndex = m_search.rewind(m_firstDirtySpineIndex);
+	}
+
+	if(firstSpineIndex == 0) {
+		initializeSearch();
+	}
+
+	m_abandoned = false;
+
+	// Noise energy expected on the correct path, up to the current spine value
+	double expectedEnergy = 0;
+	double energyVariance = 0;
+	for(unsigned int spineIndex = 0; spineIndex < firstSpineIndex; spineIndex++) {
+		expectedEnergy += m_noiseEnergy[spineIndex];
+		energyVariance += m_noiseEnergyVariance[spineIndex];
+	}
+
+	for (unsigned int spineIndex = firstSpineIndex;
+		 spineIndex < m_spineLength;
+		 spineIndex++)
+	{
+		doInference(spineIndex);
+
+		expectedEnergy += m_noiseEnergy[spineIndex];
+		energyVariance += m_noiseEnergyVariance[spineIndex];
+
+		if((m_earlyTerminationStdDevs > 0)
+				&& (spineIndex + 1 < m_spineLength)
+				&& isHopeless(expectedEnergy, energyVariance)) {
+			// The search is valid up to here, an incremental decoder can
+			// resume from the next spine value
+			m_abandoned = true;
+			m_firstDirtySpineIndex = spineIndex + 1;
+			return;
+		}
+	}
+
+	// All symbols are now accounted for in the search
+	m_firstDirtySpineIndex = m_spineLength;
+}
+
+template<typename Search>
+inline bool HashDecoder<Search>::isHopeless(double expectedEnergy,
+											double energyVariance)
+{
+	if(energyVariance <= 0) {
+		// No noise information, nothing to compare against
+		return false;
+	}
+
+	if(RenormalizesWeights<typename Search::Evaluator>::value) {
+		// Weights are relative to the best path, and may be scaled, so they
+		// cannot be compared to the noise energy
+		return false;
+	}
+
+	double bestWeight = m_search.getBestPath(m_bestPath).getWeight();
+	double margin = m_earlyTerminationStdDevs * sqrt(energyVariance);
+
+	// If the correct path is in the beam, the best path weighs at most as
+	// much. A heavier best path means the correct path was pruned. A much
+	// lighter best path means wrong paths fit the symbols better than the
+	// correct path is expected to, i.e. there are too few symbols to tell
+	// them apart.
+	return (bestWeight > expectedEnergy + margin)
+			|| (bestWeight < expectedEnergy - margin);
+}
+
 template<typename Search>
 void HashDecoder<Search>::initializeSearch() {
 	m_search.initialize();
@@ -99,14 +237,23 @@ void HashDecoder<Search>::initializeSearch() {
 template<typename Search>
 void HashDecoder<Search>::doInference(unsigned int spineIndex)
 {
-	SymbolCollection<ChannelSymbol> symbols(
-			m_storage.get(spineIndex),
-			m_storage.size(spineIndex));
+	BranchData symbols(m_storage, spineIndex);
+
+	setExpectedStepWeight(spineIndex,
+						  BoolTag<UsesExpectedWeights<Search>::value>());
 
 	// Advance the search using the symbols
 	m_search.advance(symbols);
 }
 
+template<typename Search>
+inline void HashDecoder<Search>::setExpectedStepWeight(unsigned int spineIndex,
+													   BoolTag<true>)
+{
+	// The correct path's weight grows by the noise energy of its symbols
+	m_search.setExpectedStepWeight(m_noiseEnergy[spineIndex]);
+}
+
 template<typename Search>
 void HashDecoder<Search>::getMostLikelyResult(DecodeResult & result)
 {
@@ -114,6 +261,12 @@ void HashDecoder<Search>::getMostLikelyResult(DecodeResult & result)
 	std::vector<unsigned short> resultBits;
 	m_search.getBestPath(resultBits);
 
+	// An abandoned search did not reach the end of the spine; the rest of the
+	// packet is zeros
+	if(resultBits.size() < m_spineLength) {
+		resultBits.resize(m_spineLength, 0);
+	}
+
 	// Set the packet from the path
 	Utils::unblockify(resultBits, m_k, result.packet);
 }
@@ -44,7 +44,24 @@ public:
 			const std::vector<uint16_t>& spineValueIndices,
 			std::vector<uint16_t>& outSymbols);
 
+	/**
+	 * Encodes 'numPasses' passes, with a symbol from every spine value in
+	 *     each pass (see IMultiStreamEncoder::encodePasses)
+	 */
+	virtual void encodePasses(
+			unsigned int numPasses,
+			std::vector<uint16_t>& outSymbols);
+
+	/**
+	 * Like encodePasses(), but writes into a caller-provided buffer.
+	 * @param outSymbols: [out] room for numPasses * spineLength symbols
+	 */
+	void encodePasses(unsigned int numPasses, uint16_t* outSymbols);
+
 private:
+	// The maximal number of spine values in a batch in encode()
+	static const unsigned int MAX_BATCH_SIZE = 64;
+
 	// number of bits that are incorporated into spine in each coding step
 	const unsigned int m_k;
 
@@ -56,6 +73,13 @@ private:
 
 	// Evaluator object for the spine
 	std::vector<SpineValueType> m_spine;
+
+	// Spine values that emit consecutive symbols in encode(), so they can
+	// be re-derived together
+	std::vector<SpineValueType*> m_batch;
+
+	// All spine values, in order, for encodePasses()
+	std::vector<SpineValueType*> m_spinePointers;
 };
 
 
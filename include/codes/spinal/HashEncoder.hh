@@ -3,6 +3,7 @@
  * This code is released under the MIT license (see LICENSE file).
  */
 #include <stdexcept>
+#include <algorithm>
 
 #include "../../util/Utils.h"
 #include "../../CodeBench.h"
@@ -19,6 +20,8 @@ inline HashEncoder<SpineValueType>::HashEncoder(
 	  m_spineLength(spineLength)
 {
 	m_spine.reserve(m_spineLength);
+	m_batch.reserve(MAX_BATCH_SIZE);
+	m_spinePointers.reserve(m_spineLength);
 }
 
 template<typename SpineValueType>
@@ -36,18 +39,22 @@ inline void HashEncoder<SpineValueType>::setPacket(const std::string & packet)
 	// Initialize the spine
 	m_spine.clear();
 
-	// Convert the packet into a bit vector
-	vector<bool> packetVector;
-	Utils::stringToVector(packet, packetVector);
-
-	unsigned int remainingBits = m_numMessageBits;
+	// The packet's bits, least significant bit of each byte first, are
+	// shifted into 'window' a byte at a time, and taken out k bits at a time
+	const uint8_t* bytes = (const uint8_t*)packet.data();
+	const uint64_t blockMask = (uint64_t(1) << m_k) - 1;
+	uint64_t window = 0;
+	unsigned int windowNumBits = 0;
 
 	for(unsigned int spineIndex = 0; spineIndex < m_spineLength; spineIndex++) {
 		// gather "transmitBits" bits from the stream
-		unsigned int gatheredBits = 0;
-		for(unsigned int i = 0; i < m_k; i++) {
-			gatheredBits = gatheredBits | ((packetVector[m_numMessageBits-remainingBits+i] & 0x1) << i);
+		while(windowNumBits < m_k) {
+			window |= uint64_t(*bytes++) << windowNumBits;
+			windowNumBits += 8;
 		}
+		unsigned int gatheredBits = (unsigned int)(window & blockMask);
+		window >>= m_k;
+		windowNumBits -= m_k;
 
 		// hash the state with the gathered bits to get new hash state
 		SpineValueType spineValue(spineSeed, gatheredBits);
@@ -55,9 +62,6 @@ inline void HashEncoder<SpineValueType>::setPacket(const std::string & packet)
 
 		// Save the current spine value into the spine
 		m_spine.push_back(spineValue);
-
-		// update remaining bits
-		remainingBits -= m_k;
 	}
 }
 
@@ -70,12 +74,63 @@ inline void HashEncoder<SpineValueType>::encode(
 	outSymbols.clear();
 	outSymbols.resize(numSymbols);
 
-	// Encode symbols
-	for(unsigned int i = 0; i < numSymbols; i++) {
-		// Get what spine value to get symbol from
-		uint16_t spineValueIndex = spineValueIndices[i];
+	// Encode symbols, in runs of symbols that come from distinct spine values.
+	// The order of symbols from different spine values does not matter, so
+	// each run gets its symbols with one batch call.
+	unsigned int i = 0;
+	while(i < numSymbols) {
+		unsigned int firstSymbol = i;
+		m_batch.clear();
+
+		while((i < numSymbols) && (m_batch.size() < MAX_BATCH_SIZE)) {
+			// Get what spine value to get symbol from
+			SpineValueType* spineValue = &m_spine[spineValueIndices[i]];
+
+			// Stop the run when a spine value repeats
+			if(std::find(m_batch.begin(), m_batch.end(), spineValue) != m_batch.end()) {
+				break;
+			}
+
+			m_batch.push_back(spineValue);
+			i++;
+		}
+
+		// Get the next symbol from each spine value in the run
+		SpineValueType::nextBatch(&m_batch[0],
+								  m_batch.size(),
+								  &outSymbols[firstSymbol]);
+	}
+}
+
+template<typename SpineValueType>
+inline void HashEncoder<SpineValueType>::encodePasses(
+		unsigned int numPasses,
+		std::vector<uint16_t> & outSymbols)
+{
+	outSymbols.resize(numPasses * m_spineLength);
+	if(!outSymbols.empty()) {
+		encodePasses(numPasses, &outSymbols[0]);
+	}
+}
+
+template<typename SpineValueType>
+inline void HashEncoder<SpineValueType>::encodePasses(
+		unsigned int numPasses,
+		uint16_t* outSymbols)
+{
+	if(m_spine.size() != m_spineLength) {
+		throw(std::runtime_error("setPacket() must be called before encoding"));
+	}
+
+	m_spinePointers.clear();
+	for(unsigned int spineIndex = 0; spineIndex < m_spineLength; spineIndex++) {
+		m_spinePointers.push_back(&m_spine[spineIndex]);
+	}
 
-		// Get the next symbol from that spine value
-		outSymbols[i] = m_spine[spineValueIndex].next();
+	// All spine values of a pass are distinct, so a pass is a single batch
+	for(unsigned int pass = 0; pass < numPasses; pass++) {
+		SpineValueType::nextBatch(&m_spinePointers[0],
+								  m_spineLength,
+								  outSymbols + pass * m_spineLength);
 	}
 }
@@ -51,4 +51,79 @@ public:
 	 * This version returns an extended result
 	 */
 	virtual SpinalDecodeResult decodeExtended() = 0;
+
+	/**
+	 * Enables or disables incremental decoding.
+	 *
+	 * When enabled, each decode attempt resumes the search from the lowest
+	 *   spine value that received new symbols since the previous attempt,
+	 *   instead of searching again from the root.
+	 */
+	virtual void setIncremental(bool incremental) = 0;
+
+	/**
+	 * Enables early termination of decode attempts that are likely to fail.
+	 *
+	 * While decoding, the weight of the best path is compared with the
+	 *   noise energy expected on the correct path, given the n0 of the added
+	 *   symbols. If the best path weighs more than 'numStdDevs' standard
+	 *   deviations above that, the correct path has most likely been pruned,
+	 *   and the attempt stops at that spine value. isAbandoned() then
+	 *   returns true, and more symbols should be collected before decoding
+	 *   again. The packet returned by an abandoned attempt holds the best
+	 *   path so far, followed by zeros.
+	 *
+	 * Assumes weights are squared euclidian distances between real symbols,
+	 *   and the symbols went through an AwgnChannel with the given n0.
+	 *   Decoders with renormalized weights never stop early.
+	 *
+	 * @param numStdDevs: the threshold. 0 disables early termination (the
+	 *   default).
+	 */
+	virtual void setEarlyTermination(float numStdDevs) = 0;
+
+	/**
+	 * @return true if the last decode attempt was abandoned early, because
+	 *   it was likely to fail (see setEarlyTermination)
+	 */
+	virtual bool isAbandoned() = 0;
+
+	/**
+	 * Enables a cache of spine values and their symbols, shared by all the
+	 *   decode attempts on a packet and cleared by reset(). Attempts after
+	 *   the first explore nearly the same nodes, and can take them from the
+	 *   cache instead of hashing them.
+	 *
+	 * Threaded decoders only cache the nodes their first worker branches.
+	 *
+	 * @param numEntries: the number of spine values the cache holds, rounded
+	 *   up to a power of 2. 0 disables the cache (the default).
+	 */
+	virtual void setSpineValueCache(unsigned int numEntries) = 0;
+
+	/**
+	 * @return the number of spine values found in the cache, since it was
+	 *   enabled
+	 */
+	virtual uint64_t spineValueCacheHits() = 0;
+
+	/**
+	 * @return the number of spine values that were not in the cache, and were
+	 *   hashed, since it was enabled
+	 */
+	virtual uint64_t spineValueCacheMisses() = 0;
+
+	/**
+	 * Limits the decoder's backtracking information to the newest
+	 *   'numLayers' spine values, so its memory does not grow with the spine
+	 *   length. Older spine values are committed once all paths in the beam
+	 *   share them, or, if the paths diverge for longer than the window, to
+	 *   the best path's spine values.
+	 *
+	 * Stack decoders do not keep backtracking layers, and ignore the window.
+	 *
+	 * @param numLayers: the number of spine values to keep, at least 2. 0
+	 *   keeps all spine values (the default).
+	 */
+	virtual void setTracebackWindow(unsigned int numLayers) = 0;
 };
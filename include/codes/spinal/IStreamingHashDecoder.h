@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <tr1/memory>
+#include "../IDecoder.h"
+
+/**
+ * \ingroup spinal
+ * \brief Receives the message blocks a streaming decoder commits to.
+ */
+class IStreamingDecodeCallback {
+public:
+	typedef std::tr1::shared_ptr<IStreamingDecodeCallback> Ptr;
+
+	/**
+	 * Virtual d'tor
+	 */
+	virtual ~IStreamingDecodeCallback() {}
+
+	/**
+	 * Called with newly committed blocks.
+	 *
+	 * @param firstSpineIndex: the spine value of the first block
+	 * @param blocks: the k message bits of each spine value, from
+	 *     'firstSpineIndex' on (see Utils::unblockify)
+	 */
+	virtual void onBlocks(unsigned int firstSpineIndex,
+						  const std::vector<unsigned short>& blocks) = 0;
+};
+
+/**
+ * \ingroup spinal
+ * \brief Decoder for spinal codes that outputs the message while symbols
+ *     arrive.
+ *
+ * Symbols are added in the order of their spine values. The search advances
+ *     over a spine value once symbols of a later spine value arrive, and the
+ *     message bits of a spine value are committed once the search is
+ *     'commitDistance' spine values past it. Committed bits are final, so the
+ *     decoder only keeps symbols and backtracking information for the spine
+ *     values it has not committed to, and its memory does not grow with the
+ *     message length.
+ *
+ * Committed blocks are passed to the callback, if one is set, and are kept
+ *     until takeBlocks() otherwise.
+ */
+template<typename ChannelSymbol>
+class IStreamingHashDecoder {
+public:
+	typedef std::tr1::shared_ptr< IStreamingHashDecoder<ChannelSymbol> > Ptr;
+
+	/**
+	 * Virtual d'tor
+	 */
+	virtual ~IStreamingHashDecoder() {}
+
+	/**
+	 * Resets the decoder, so a different message can be decoded
+	 */
+	virtual void reset() = 0;
+
+	/**
+	 * Sets the callback that receives committed blocks. NULL keeps the
+	 *     blocks until takeBlocks() (the default).
+	 */
+	virtual void setCallback(IStreamingDecodeCallback::Ptr callback) = 0;
+
+	/**
+	 * Adds symbols, and commits the blocks that fell 'commitDistance' spine
+	 *     values behind the search.
+	 *
+	 * @param spineValueIndices: the spine value of each symbol. Indices must
+	 *     not decrease, within a call and between calls.
+	 * @param symbols: the symbols to add
+	 */
+	virtual void add(const std::vector<unsigned int>& spineValueIndices,
+					 const std::vector<ChannelSymbol>& symbols,
+					 N0_t n0) = 0;
+
+	/**
+	 * Advances the search to the end of the spine, and commits the remaining
+	 *     blocks. Symbols cannot be added afterwards, until reset().
+	 */
+	virtual void finish() = 0;
+
+	/**
+	 * @return the number of blocks committed since reset()
+	 */
+	virtual unsigned int numCommitted() = 0;
+
+	/**
+	 * Moves the committed blocks that were not passed to a callback into
+	 *     'blocks'
+	 */
+	virtual void takeBlocks(std::vector<unsigned short>& blocks) = 0;
+};
@@ -5,7 +5,13 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <stdint.h>
+#include "../../util/SizedArray.h"
+#include "../../util/inference/hmm/SoADualPool.h"
+#include "../../util/inference/hmm/WeightTraits.h"
+#include "FlatSymbolStorage.h"
+#include "SpineValueCache.h"
 #include "../../CodeBench.h"
 #include "../../channels/CoherenceFading.h"
 
@@ -51,6 +57,53 @@ public:
 	static Weight dist(FadingSymbol x, FadingSymbol y);
 };
 
+/**
+ * \ingroup spinal
+ * \brief Computes the euclidian distance between two integer symbols, into a
+ *    narrow unsigned weight
+ *
+ * The squared distance is shifted right by 'shift' bits, and saturates at the
+ *    largest Weight. Path weights grow without bound, so searches using this
+ *    distance renormalize them after every step (see RenormalizesWeights).
+ *    Paths much worse than the best then saturate, and tie.
+ *
+ * Weight is uint16_t or uint32_t. Narrower weights make nodes and distance
+ *    tables smaller, at the cost of resolution.
+ */
+template<typename WeightType>
+class SaturatingEuclidianDistance {
+public:
+	typedef WeightType Weight;
+	enum { RENORMALIZE_WEIGHTS = 1 };
+
+	/**
+	 * C'tor
+	 * @param shift: the number of LSBs dropped from squared distances
+	 */
+	SaturatingEuclidianDistance(unsigned int shift = 0) : m_shift(shift) {}
+
+	Weight dist(Symbol x, Symbol y) const;
+
+private:
+	unsigned int m_shift;
+};
+
+/**
+ * \ingroup spinal
+ * \brief Computes the euclidian distance between two symbols, into a float
+ *
+ * Float weights lose resolution as they grow, so searches renormalize them
+ *    after every step (see RenormalizesWeights).
+ */
+template<typename ChannelSymbol>
+class FloatEuclidianDistance {
+public:
+	typedef float Weight;
+	enum { RENORMALIZE_WEIGHTS = 1 };
+
+	static Weight dist(ChannelSymbol x, ChannelSymbol y);
+};
+
 /**
  * \ingroup spinal
  * \brief The Node struct keeps information on one node in the explored tree
@@ -74,6 +127,28 @@ struct SpinalNode {
 	SpineValueSeed hash;
 };
 
+/**
+ * \ingroup spinal
+ * \brief Splits SpinalNode into fields, so it can be kept in a SoADualPool
+ */
+template<typename SpineValueSeed, typename WeightType>
+struct SoANodeTraits< SpinalNode<SpineValueSeed, WeightType> > {
+	typedef SpinalNode<SpineValueSeed, WeightType> Node;
+	typedef WeightType Weight;
+	typedef SpineValueSeed Seed;
+	typedef WeightType Extra;
+
+	static Weight weight(const Node& node) {return node.likelihood;}
+	static Seed seed(const Node& node) {return node.hash;}
+	static Extra extra(const Node& node) {return node.lastCodeStepLikelihood;}
+
+	static void assemble(Weight weight, Seed seed, Extra extra, Node& node) {
+		node.likelihood = weight;
+		node.hash = seed;
+		node.lastCodeStepLikelihood = extra;
+	}
+};
+
 /**
  * \ingroup spinal
  * \brief A container for a group of symbols
@@ -84,6 +159,11 @@ struct SymbolCollection {
 	SymbolCollection(const ChannelSymbol* _data, unsigned int _size)
 	   : data(_data), size(_size) {}
 
+	// C'tor, from the symbols stored for a spine value
+	SymbolCollection(FlatSymbolStorage<ChannelSymbol>& storage,
+					 unsigned int spineValueInd)
+	   : data(storage.get(spineValueInd)), size(storage.size(spineValueInd)) {}
+
 	// The data the collection holds.
 	const ChannelSymbol* data;
 
@@ -95,23 +175,91 @@ struct SymbolCollection {
 /**
  * \ingroup spinal
  * \brief Evaluates likelihoods of branches in the decoding tree
+ *
+ * When FIXED_K is non-zero, k is fixed at compile time: loops over a node's
+ *    children have a constant trip count, and per-child buffers are stored
+ *    inline. The k given to the constructor must then equal FIXED_K.
+ *
+ * Distances may keep parameters, so the evaluator holds a Distance instance.
+ *
+ * When the evaluator's spine value cache is enabled, spine values and their
+ *    symbols are taken from the cache instead of being hashed.
  */
-template<typename SpineValueType, typename ChannelTransformation, typename Distance>
+template<typename SpineValueType,
+		 typename ChannelTransformation,
+		 typename Distance,
+		 unsigned int FIXED_K = 0>
 class SpinalBranchEvaluator {
+private:
+	// The number of children if fixed at compile time, 0 otherwise
+	enum { FIXED_NUM_CHILDREN = (FIXED_K == 0) ? 0 : (1 << FIXED_K) };
+
 public:
 	typedef typename Distance::Weight Weight;
 	typedef typename ChannelTransformation::OutputType ChannelSymbol;
 
 	typedef SpinalNode<typename SpineValueType::Seed, Weight> Node;
 	typedef SymbolCollection< ChannelSymbol > BranchData;
+	typedef FlatSymbolStorage<ChannelSymbol> SymbolStorage;
+
+	// Searches renormalize weights if the distance needs it
+	enum { RENORMALIZE_WEIGHTS = RenormalizesWeights<Distance>::value };
 
 	/**
 	 * C'tor
 	 *
 	 * @param xform: the transform that maps encoder output to symbols
 	 * @param k: the size of k for the code
+	 * @param distance: the distance between symbols
 	 */
-	SpinalBranchEvaluator(const ChannelTransformation& xform, uint32_t k);
+	SpinalBranchEvaluator(const ChannelTransformation& xform,
+						  uint32_t k,
+						  const Distance& distance = Distance());
+
+	/**
+	 * The same evaluator with k fixed at compile time
+	 */
+	template<unsigned int K>
+	struct WithFixedK {
+		typedef SpinalBranchEvaluator<SpineValueType,
+									  ChannelTransformation,
+									  Distance,
+									  K> Type;
+
+		static Type convert(const SpinalBranchEvaluator& evaluator) {
+			return Type(evaluator.transformation(),
+						evaluator.k(),
+						evaluator.distance());
+		}
+	};
+
+	/**
+	 * @return the transform that maps encoder output to symbols
+	 */
+	const ChannelTransformation& transformation() const;
+
+	/**
+	 * @return the size of k for the code
+	 */
+	uint32_t k() const;
+
+	/**
+	 * @return the distance between symbols
+	 */
+	const Distance& distance() const;
+
+	/**
+	 * @return the cache of spine values. It is disabled until resized.
+	 */
+	SpineValueCache<SpineValueType>& spineValueCache();
+
+	/**
+	 * Makes the storage where a decoder keeps the symbols it receives.
+	 *    BranchData for a spine value is constructed from the storage.
+	 */
+	SymbolStorage symbolStorage(unsigned int spineLength,
+								unsigned int maxNumSymbolsPerValue,
+								unsigned int maxNumSymbolsLastValue) const;
 
 	/**
 	 * Advances the spine from 'parent', using 'edge' as input message bits. The
@@ -125,6 +273,20 @@ public:
 				BranchData& syms,
 				Node& child);
 
+	/**
+	 * Advances the spine from 'parent' along all 2^k edges. The child reached
+	 *    with edge 'e' is stored in children[e].
+	 *
+	 * The result is identical to calling branch() for every edge, but the
+	 *    children's symbols are stored interleaved, so their distances are
+	 *    accumulated side by side and can be computed in SIMD lanes.
+	 *
+	 * @note children must not contain parent.
+	 */
+	void branchAll(Node& parent,
+				   BranchData& syms,
+				   Node* children);
+
 	/**
 	 * Initializes Node objects for the first time. This is instead of using a
 	 *     factory (in order to avoid pointer dereferences). initNode should
@@ -134,13 +296,35 @@ public:
 	 */
 	void initNode(Node& node);
 
+	/**
+	 * Subtracts 'offset' from the node's path weight. Only used when
+	 *     RENORMALIZE_WEIGHTS is set.
+	 */
+	void renormalize(Node& node, Weight offset);
+
 private:
+	/**
+	 * @return the number of children of each node, 2^k
+	 */
+	unsigned int numChildren() const {
+		return (FIXED_K != 0) ? (unsigned int)FIXED_NUM_CHILDREN : m_numChildren;
+	}
+
 	// K for each of the decoders
 	const uint32_t m_k;
 
+	// The distance between symbols
+	Distance m_distance;
+
+	// Spine values from previous branches, if enabled
+	SpineValueCache<SpineValueType> m_cache;
+
 	// Mask to extract k LSB bits
 	const uint32_t m_mask;
 
+	// Number of children of each node, 2^k
+	const uint32_t m_numChildren;
+
 	// ChannelTransformation from bits to symbols
 	ChannelTransformation m_xform;
 
@@ -152,11 +336,78 @@ private:
 
 	// Symbols that had been observed, according to BranchData
 	std::vector<typename ChannelTransformation::OutputType> m_observedSymbols;
+
+	// Buffers for branchAll(). Symbol i of child e is stored in entry
+	// (i * m_numChildren + e), so all children's i'th symbols are adjacent
+	std::vector<uint16_t> m_allEncodedSymbols;
+	std::vector<ChannelSymbol> m_allObservedSymbols;
+	std::vector<ChannelSymbol> m_allCandidateSymbols;
+
+	// The likelihood of the last step for each child, in branchAll()
+	SizedArray<Weight, FIXED_NUM_CHILDREN> m_stepLikelihoods;
+
+	// Inputs to batch hashing in branchAll(): the parent's seed for every
+	// child, and the edge leading to every child
+	SizedArray<typename SpineValueType::Seed, FIXED_NUM_CHILDREN> m_parentSeeds;
+	SizedArray<uint32_t, FIXED_NUM_CHILDREN> m_edges;
+
+	// The children's seeds, when taken from the cache in branchAll()
+	SizedArray<typename SpineValueType::Seed, FIXED_NUM_CHILDREN> m_childSeeds;
+
+	// The children's spine values in branchAll(), and pointers to them
+	SizedArray<SpineValueType, FIXED_NUM_CHILDREN> m_childSpineValues;
+	SizedArray<SpineValueType*, FIXED_NUM_CHILDREN> m_childSpineValuePtrs;
 };
 
 
 // IMPLEMENTATION
 
+#include <stdexcept>
+#include "../../util/Utils.h"
+
+// DISTANCE FUNCTIONS
+
+inline uint64_t IntegerEuclidianDistance::dist(Symbol x, Symbol y)
+{
+	int64_t delta = ((int64_t)(x) - (int64_t)(y));
+	return delta * delta;
+}
+
+inline uint32_t HammingDistance::dist(Symbol x, Symbol y)
+{
+	return Utils::popcount_2(x ^ y);
+}
+
+inline double FadingEuclidianDistance::dist(FadingSymbol x,
+											FadingSymbol y)
+{
+	SoftSymbol delta = (x.symbol - y.symbol);
+	return double(delta * delta);
+}
+
+inline double SoftEuclidianDistance::dist(SoftSymbol x, SoftSymbol y)
+{
+	SoftSymbol delta = x - y;
+	return double(delta * delta);
+}
+
+template<typename WeightType>
+inline WeightType SaturatingEuclidianDistance<WeightType>::dist(Symbol x,
+																Symbol y) const
+{
+	int64_t delta = ((int64_t)(x) - (int64_t)(y));
+	uint64_t scaled = uint64_t(delta * delta) >> m_shift;
+	const uint64_t maxWeight = WeightType(~WeightType(0));
+	return WeightType(std::min(scaled, maxWeight));
+}
+
+template<typename ChannelSymbol>
+inline float FloatEuclidianDistance<ChannelSymbol>::dist(ChannelSymbol x,
+														 ChannelSymbol y)
+{
+	float delta = float(x) - float(y);
+	return delta * delta;
+}
 
 // SPINAL NODE
 template<typename SpineValue, typename WeightType>
@@ -167,20 +418,81 @@ inline bool SpinalNode<SpineValue, WeightType>::operator <(const SpinalNode & ot
 
 // LOOKAHEAD BRANCH EVALUATOR
 
-template<typename SpineValueType, typename ChannelTransformation, typename Distance>
-inline SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance>
-	::SpinalBranchEvaluator(const ChannelTransformation & xform, uint32_t k)
+template<typename SpineValueType, typename ChannelTransformation, typename Distance, unsigned int FIXED_K>
+inline SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>
+	::SpinalBranchEvaluator(const ChannelTransformation & xform,
+							uint32_t k,
+							const Distance& distance)
 	 : m_k(k),
+	   m_distance(distance),
 	   m_mask((1 << m_k) - 1),
-	   m_xform(xform)
+	   m_numChildren(1 << m_k),
+	   m_xform(xform),
+	   m_stepLikelihoods(m_numChildren),
+	   m_parentSeeds(m_numChildren),
+	   m_edges(m_numChildren),
+	   m_childSeeds(m_numChildren),
+	   m_childSpineValues(m_numChildren),
+	   m_childSpineValuePtrs(m_numChildren)
 {
+	if((FIXED_K != 0) && (m_k != FIXED_K)) {
+		throw(std::runtime_error("k does not match the evaluator's fixed k"));
+	}
+
+	for(unsigned int edge = 0; edge < m_numChildren; edge++) {
+		m_edges[edge] = edge;
+	}
+
 	m_encodedSymbols.reserve(100);
 	m_candidateSymbols.reserve(100);
 	m_observedSymbols.reserve(100);
+
+	m_allEncodedSymbols.reserve(100 * m_numChildren);
+	m_allObservedSymbols.reserve(100 * m_numChildren);
+	m_allCandidateSymbols.reserve(100 * m_numChildren);
+}
+
+template<typename SpineValueType, typename ChannelTransformation, typename Distance, unsigned int FIXED_K>
+inline const ChannelTransformation&
+SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>::transformation() const
+{
+	return m_xform;
+}
+
+template<typename SpineValueType, typename ChannelTransformation, typename Distance, unsigned int FIXED_K>
+inline uint32_t SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>::k() const
+{
+	return m_k;
+}
+
+template<typename SpineValueType, typename ChannelTransformation, typename Distance, unsigned int FIXED_K>
+inline const Distance&
+SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>::distance() const
+{
+	return m_distance;
+}
+
+template<typename SpineValueType, typename ChannelTransformation, typename Distance, unsigned int FIXED_K>
+inline SpineValueCache<SpineValueType>&
+SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>::spineValueCache()
+{
+	return m_cache;
+}
+
+template<typename SpineValueType, typename ChannelTransformation, typename Distance, unsigned int FIXED_K>
+inline typename SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>::SymbolStorage
+SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>::symbolStorage(
+		unsigned int spineLength,
+		unsigned int maxNumSymbolsPerValue,
+		unsigned int maxNumSymbolsLastValue) const
+{
+	return SymbolStorage(spineLength,
+						 maxNumSymbolsPerValue,
+						 maxNumSymbolsLastValue);
 }
 
-template<typename SpineValueType, typename ChannelTransformation, typename Distance>
-inline void SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance>
+template<typename SpineValueType, typename ChannelTransformation, typename Distance, unsigned int FIXED_K>
+inline void SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>
 	::branch(Node & parent, unsigned int edge,  BranchData& syms, Node & child)
 {
 
@@ -191,13 +503,22 @@ inline void SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance>
 	unsigned int numEncodedSymbols = m_xform.forecast(syms.size);
 	m_encodedSymbols.resize(numEncodedSymbols);
 
-	// generate the next spine value from the bits
-	SpineValueType spineValue(parent.hash, edge);
-	child.hash = spineValue.getSeed();
-
-	// Calculate encoded symbols for the encoded
-	for(unsigned int i = 0; i < numEncodedSymbols; i++) {
-		m_encodedSymbols[i] = spineValue.next();
+	if(m_cache.isEnabled()) {
+		child.hash = m_cache.generate(
+				parent.hash,
+				edge,
+				numEncodedSymbols,
+				(numEncodedSymbols > 0) ? &m_encodedSymbols[0] : NULL,
+				1);
+	} else {
+		// generate the next spine value from the bits
+		SpineValueType spineValue(parent.hash, edge);
+		child.hash = spineValue.getSeed();
+
+		// Calculate encoded symbols for the encoded
+		for(unsigned int i = 0; i < numEncodedSymbols; i++) {
+			m_encodedSymbols[i] = spineValue.next();
+		}
 	}
 
 	// Get observed symbols into a vector
@@ -210,14 +531,113 @@ inline void SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance>
 	for(unsigned int i = 0; i < syms.size; i++) {
 		// calculate the log likelihood of the proposed symbol, given
 		// the actual symbol received
-		stepLikelihood += Distance::dist(syms.data[i], m_candidateSymbols[i]);
+		stepLikelihood = WeightTraits<Weight>::add(
+				stepLikelihood,
+				m_distance.dist(syms.data[i], m_candidateSymbols[i]));
 	}
 
 	child.lastCodeStepLikelihood = stepLikelihood;
-	child.likelihood = parent.likelihood + stepLikelihood;
+	child.likelihood = WeightTraits<Weight>::add(parent.likelihood, stepLikelihood);
+}
+
+template<typename SpineValueType, typename ChannelTransformation, typename Distance, unsigned int FIXED_K>
+inline void SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>
+	::branchAll(Node & parent, BranchData& syms, Node* children)
+{
+	const unsigned int numChildren = this->numChildren();
+	const unsigned int numEncodedSymbols = m_xform.forecast(syms.size);
+
+	if(numEncodedSymbols != syms.size) {
+		// The transformation combines several encoded symbols into one channel
+		// symbol, so interleaving children's symbols would mix them up.
+		for(unsigned int edge = 0; edge < numChildren; edge++) {
+			branch(parent, edge, syms, children[edge]);
+		}
+		return;
+	}
+
+	// Buffers only grow, so they are not reallocated once warmed up
+	m_allEncodedSymbols.resize(numEncodedSymbols * numChildren);
+	m_allObservedSymbols.resize(syms.size * numChildren);
+
+	if(m_cache.isEnabled()) {
+		// The children's symbols are copied from the cache into place
+		m_cache.generateChildren(
+				parent.hash,
+				numChildren,
+				numEncodedSymbols,
+				(numEncodedSymbols > 0) ? &m_allEncodedSymbols[0] : NULL,
+				&m_childSeeds[0]);
+
+		for(unsigned int edge = 0; edge < numChildren; edge++) {
+			children[edge].hash = m_childSeeds[edge];
+		}
+	} else {
+		// generate all children's spine values together
+		std::fill(m_parentSeeds.begin(), m_parentSeeds.end(), parent.hash);
+		SpineValueType::hashBatch(&m_parentSeeds[0],
+								  &m_edges[0],
+								  numChildren,
+								  &m_childSpineValues[0]);
+
+		for(unsigned int edge = 0; edge < numChildren; edge++) {
+			children[edge].hash = m_childSpineValues[edge].getSeed();
+
+			// Pointers are set here, since a copied evaluator would otherwise
+			// point to the original's spine values
+			m_childSpineValuePtrs[edge] = &m_childSpineValues[edge];
+		}
+
+		// Symbol i of all children is generated together, directly into place
+		for(unsigned int i = 0; i < numEncodedSymbols; i++) {
+			SpineValueType::nextBatch(&m_childSpineValuePtrs[0],
+									  numChildren,
+									  &m_allEncodedSymbols[i * numChildren]);
+		}
+	}
+
+	// Each child is compared against the same observed symbols
+	for(unsigned int i = 0; i < syms.size; i++) {
+		std::fill(m_allObservedSymbols.begin() + i * numChildren,
+				  m_allObservedSymbols.begin() + (i + 1) * numChildren,
+				  syms.data[i]);
+	}
+
+	// Transform all children's symbols in one call
+	m_xform.transform(m_allEncodedSymbols,
+					  m_allObservedSymbols,
+					  m_allCandidateSymbols);
+
+	// Accumulate distances. Every child sums its symbols in the same order as
+	// branch() does, so the results are identical.
+	Weight* stepLikelihoods = &m_stepLikelihoods[0];
+	std::fill(stepLikelihoods, stepLikelihoods + numChildren, Weight(0));
+	for(unsigned int i = 0; i < syms.size; i++) {
+		const ChannelSymbol observed = syms.data[i];
+		const ChannelSymbol* candidates = &m_allCandidateSymbols[i * numChildren];
+
+		for(unsigned int edge = 0; edge < numChildren; edge++) {
+			stepLikelihoods[edge] = WeightTraits<Weight>::add(
+					stepLikelihoods[edge],
+					m_distance.dist(observed, candidates[edge]));
+		}
+	}
+
+	for(unsigned int edge = 0; edge < numChildren; edge++) {
+		children[edge].lastCodeStepLikelihood = stepLikelihoods[edge];
+		children[edge].likelihood = WeightTraits<Weight>::add(parent.likelihood,
+															  stepLikelihoods[edge]);
+	}
 }
 
-template<typename SpineValueType, typename ChannelTransformation, typename Distance>
-inline void SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance>::initNode(Node & node)
+template<typename SpineValueType, typename ChannelTransformation, typename Distance, unsigned int FIXED_K>
+inline void SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>::initNode(Node & node)
 {// We don't have to do anything in this case.
 }
+
+template<typename SpineValueType, typename ChannelTransformation, typename Distance, unsigned int FIXED_K>
+inline void SpinalBranchEvaluator<SpineValueType,ChannelTransformation,Distance,FIXED_K>
+	::renormalize(Node & node, Weight offset)
+{
+	node.likelihood -= offset;
+}
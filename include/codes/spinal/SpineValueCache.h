@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+/**
+ * \ingroup spinal
+ * \brief Remembers spine values and the symbols they generated, so repeated
+ *    decode attempts do not hash them again.
+ *
+ * Consecutive decode attempts on a packet explore nearly the same nodes near
+ *    the root. The cache maps a (parent seed, edge) pair to the child's seed
+ *    and to the first symbols generated from the child. It also keeps the
+ *    child's hash state, so when a later attempt needs more symbols (after
+ *    another pass was received), only the new symbols are generated.
+ *
+ * The cache has a fixed number of entries, and uses open addressing with a
+ *    short probe sequence. When all probed entries are taken, the first one
+ *    is replaced. The result of a lookup only depends on the seed and edge,
+ *    so replacing or clearing entries never changes decoding results.
+ *
+ * A cache with no entries is disabled; that is the default.
+ */
+template<typename SpineValueType>
+class SpineValueCache {
+public:
+	typedef typename SpineValueType::Seed Seed;
+
+	/**
+	 * C'tor. Makes a disabled cache.
+	 */
+	SpineValueCache();
+
+	/**
+	 * Sets the number of entries, removing all entries and resetting the
+	 *     hit and miss counters.
+	 *
+	 * @param numEntries: the number of entries, rounded up to a power of 2.
+	 *     0 disables the cache.
+	 */
+	void resize(unsigned int numEntries);
+
+	/**
+	 * @return true if the cache has entries
+	 */
+	bool isEnabled() const;
+
+	/**
+	 * Removes all entries. Hit and miss counters are kept.
+	 */
+	void clear();
+
+	/**
+	 * Generates 'numSymbols' symbols from the spine value that follows
+	 *     'parentSeed' with 'edge', and returns its seed. Equivalent to
+	 *     SpineValueType value(parentSeed, edge), then setting
+	 *     out[i * stride] = value.next() for i in [0, numSymbols) and
+	 *     returning value.getSeed().
+	 *
+	 * @note the cache must be enabled
+	 */
+	Seed generate(const Seed& parentSeed,
+				  uint32_t edge,
+				  unsigned int numSymbols,
+				  uint16_t* out,
+				  unsigned int stride);
+
+	/**
+	 * Generates 'numSymbols' symbols from each of the first 'numChildren'
+	 *     children of 'parentSeed', as generate() with edges 0 to
+	 *     numChildren - 1. Symbol i of the child with edge e is written to
+	 *     out[i * numChildren + e], and its seed to childSeeds[e].
+	 *
+	 * Children that are not in the cache are hashed together, with
+	 *     SpineValueType::hashBatch().
+	 *
+	 * @note the cache must be enabled
+	 */
+	void generateChildren(const Seed& parentSeed,
+						  unsigned int numChildren,
+						  unsigned int numSymbols,
+						  uint16_t* out,
+						  Seed* childSeeds);
+
+	/**
+	 * @return the number of spine values that were found in the cache
+	 */
+	uint64_t numHits() const;
+
+	/**
+	 * @return the number of spine values that were not in the cache, and had
+	 *     to be hashed
+	 */
+	uint64_t numMisses() const;
+
+private:
+	// The number of symbols kept in an entry. Further symbols are generated
+	// from a copy of the entry's hash state on every call.
+	enum { SYMBOLS_PER_ENTRY = 16 };
+
+	// The number of entries examined before an entry is replaced
+	enum { MAX_PROBES = 4 };
+
+	struct Entry {
+		Entry() : epoch(0) {}
+
+		// The entry is valid if its epoch is the cache's epoch
+		uint32_t epoch;
+
+		// The key
+		Seed parentSeed;
+		uint32_t edge;
+
+		// The child's seed
+		Seed seed;
+
+		// The child's hash state, after generating 'numSymbols' symbols
+		SpineValueType state;
+
+		// Symbols generated so far
+		uint16_t numSymbols;
+		uint16_t symbols[SYMBOLS_PER_ENTRY];
+	};
+
+	/**
+	 * @return the index of the first entry probed for the key
+	 */
+	unsigned int home(const Seed& parentSeed, uint32_t edge) const;
+
+	/**
+	 * @return the entry for the key, or NULL if it is not in the cache
+	 */
+	Entry* find(const Seed& parentSeed, uint32_t edge);
+
+	/**
+	 * Puts a newly hashed spine value in the cache, replacing an entry if
+	 *     needed
+	 * @return the new entry
+	 */
+	Entry& insert(const Seed& parentSeed,
+				  uint32_t edge,
+				  const SpineValueType& value);
+
+	/**
+	 * Writes the entry's first 'numSymbols' symbols to out[i * stride],
+	 *     generating symbols that are not in the entry yet
+	 */
+	void copySymbols(Entry& entry,
+					 unsigned int numSymbols,
+					 uint16_t* out,
+					 unsigned int stride);
+
+	// The entries
+	std::vector<Entry> m_entries;
+
+	// The number of entries minus 1
+	unsigned int m_mask;
+
+	// Entries from other epochs are empty; clear() starts a new epoch
+	uint32_t m_epoch;
+
+	uint64_t m_numHits;
+	uint64_t m_numMisses;
+
+	// Children missing from the cache in generateChildren(), their parent
+	// seeds and their hashed spine values
+	std::vector<uint32_t> m_missingEdges;
+	std::vector<Seed> m_missingParentSeeds;
+	std::vector<SpineValueType> m_missingValues;
+};
+
+
+// IMPLEMENTATION
+
+template<typename SpineValueType>
+inline SpineValueCache<SpineValueType>::SpineValueCache()
+  : m_mask(0),
+    m_epoch(1),
+    m_numHits(0),
+    m_numMisses(0)
+{}
+
+template<typename SpineValueType>
+inline void SpineValueCache<SpineValueType>::resize(unsigned int numEntries)
+{
+	unsigned int size = 0;
+	if(numEntries > 0) {
+		size = 1;
+		while(size < numEntries) {
+			size <<= 1;
+		}
+	}
+
+	m_entries.assign(size, Entry());
+	m_mask = (size > 0) ? (size - 1) : 0;
+	m_epoch = 1;
+	m_numHits = 0;
+	m_numMisses = 0;
+}
+
+template<typename SpineValueType>
+inline bool SpineValueCache<SpineValueType>::isEnabled() const
+{
+	return !m_entries.empty();
+}
+
+template<typename SpineValueType>
+inline void SpineValueCache<SpineValueType>::clear()
+{
+	m_epoch++;
+	if(m_epoch == 0) {
+		// The epoch wrapped around, so old entries could seem valid
+		m_entries.assign(m_entries.size(), Entry());
+		m_epoch = 1;
+	}
+}
+
+template<typename SpineValueType>
+inline unsigned int SpineValueCache<SpineValueType>::home(
+		const Seed& parentSeed,
+		uint32_t edge) const
+{
+	uint64_t key = ((uint64_t)parentSeed * 0x9E3779B97F4A7C15ull)
+					^ ((uint64_t)edge * 0xC2B2AE3D27D4EB4Full);
+	return (unsigned int)(key >> 32);
+}
+
+template<typename SpineValueType>
+inline typename SpineValueCache<SpineValueType>::Entry*
+SpineValueCache<SpineValueType>::find(const Seed& parentSeed, uint32_t edge)
+{
+	unsigned int first = home(parentSeed, edge);
+
+	for(unsigned int probe = 0; probe < MAX_PROBES; probe++) {
+		Entry& entry = m_entries[(first + probe) & m_mask];
+		if((entry.epoch == m_epoch)
+				&& (entry.parentSeed == parentSeed)
+				&& (entry.edge == edge)) {
+			return &entry;
+		}
+	}
+
+	return NULL;
+}
+
+template<typename SpineValueType>
+inline typename SpineValueCache<SpineValueType>::Entry&
+SpineValueCache<SpineValueType>::insert(const Seed& parentSeed,
+										uint32_t edge,
+										const SpineValueType& value)
+{
+	unsigned int first = home(parentSeed, edge);
+
+	// Take the first empty entry, or replace the first entry probed
+	Entry* entry = &m_entries[first & m_mask];
+	for(unsigned int probe = 0; probe < MAX_PROBES; probe++) {
+		Entry& candidate = m_entries[(first + probe) & m_mask];
+		if(candidate.epoch != m_epoch) {
+			entry = &candidate;
+			break;
+		}
+	}
+
+	entry->epoch = m_epoch;
+	entry->parentSeed = parentSeed;
+	entry->edge = edge;
+	entry->state = value;
+	entry->seed = entry->state.getSeed();
+	entry->numSymbols = 0;
+	return *entry;
+}
+
+template<typename SpineValueType>
+inline void SpineValueCache<SpineValueType>::copySymbols(Entry& entry,
+														 unsigned int numSymbols,
+														 uint16_t* out,
+														 unsigned int stride)
+{
+	// Keep new symbols in the entry while there is room
+	unsigned int numStored = std::min(numSymbols,
+									  (unsigned int)SYMBOLS_PER_ENTRY);
+	while(entry.numSymbols < numStored) {
+		entry.symbols[entry.numSymbols++] = entry.state.next();
+	}
+
+	for(unsigned int i = 0; i < numStored; i++) {
+		out[i * stride] = entry.symbols[i];
+	}
+
+	if(numSymbols > numStored) {
+		// The rest continue from the stored state, which stays unchanged
+		SpineValueType value(entry.state);
+		for(unsigned int i = numStored; i < numSymbols; i++) {
+			out[i * stride] = value.next();
+		}
+	}
+}
+
+template<typename SpineValueType>
+inline typename SpineValueCache<SpineValueType>::Seed
+SpineValueCache<SpineValueType>::generate(const Seed& parentSeed,
+										  uint32_t edge,
+										  unsigned int numSymbols,
+										  uint16_t* out,
+										  unsigned int stride)
+{
+	Entry* entry = find(parentSeed, edge);
+
+	if(entry != NULL) {
+		m_numHits++;
+	} else {
+		m_numMisses++;
+		entry = &insert(parentSeed, edge, SpineValueType(parentSeed, edge));
+	}
+
+	copySymbols(*entry, numSymbols, out, stride);
+	return entry->seed;
+}
+
+template<typename SpineValueType>
+inline void SpineValueCache<SpineValueType>::generateChildren(
+		const Seed& parentSeed,
+		unsigned int numChildren,
+		unsigned int numSymbols,
+		uint16_t* out,
+		Seed* childSeeds)
+{
+	m_missingEdges.clear();
+
+	for(unsigned int edge = 0; edge < numChildren; edge++) {
+		Entry* entry = find(parentSeed, edge);
+		if(entry == NULL) {
+			m_missingEdges.push_back(edge);
+			continue;
+		}
+
+		m_numHits++;
+		copySymbols(*entry, numSymbols, out + edge, numChildren);
+		childSeeds[edge] = entry->seed;
+	}
+
+	const unsigned int numMissing = m_missingEdges.size();
+	if(numMissing == 0) {
+		return;
+	}
+	m_numMisses += numMissing;
+
+	// Hash all missing children together
+	m_missingParentSeeds.assign(numMissing, parentSeed);
+	m_missingValues.resize(numMissing);
+	SpineValueType::hashBatch(&m_missingParentSeeds[0],
+							  &m_missingEdges[0],
+							  numMissing,
+							  &m_missingValues[0]);
+
+	for(unsigned int i = 0; i < numMissing; i++) {
+		unsigned int edge = m_missingEdges[i];
+		Entry& entry = insert(parentSeed, edge, m_missingValues[i]);
+		copySymbols(entry, numSymbols, out + edge, numChildren);
+		childSeeds[edge] = entry.seed;
+	}
+}
+
+template<typename SpineValueType>
+inline uint64_t SpineValueCache<SpineValueType>::numHits() const
+{
+	return m_numHits;
+}
+
+template<typename SpineValueType>
+inline uint64_t SpineValueCache<SpineValueType>::numMisses() const
+{
+	return m_numMisses;
+}
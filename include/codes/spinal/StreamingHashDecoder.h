@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <vector>
+
+#include "IStreamingHashDecoder.h"
+
+/**
+ * \ingroup spinal
+ * \brief Streaming decoder for spinal codes
+ *
+ * The search runs one spine value behind the newest symbols: symbols of the
+ *     front spine value are collected in a symbol storage that holds a single
+ *     spine value, and the search advances over it when a symbol of a later
+ *     spine value arrives. After each step, the best path's blocks that are
+ *     more than 'commitDistance' spine values behind the front are committed.
+ *
+ * The search is built with a depth of commitDistance + 1. Its backtracker
+ *     then keeps only the layers that were not committed, overwriting older
+ *     layers (see Backtracker), and getBestPath() is asked for the path from
+ *     the first uncommitted layer.
+ */
+template<typename Search>
+class StreamingHashDecoder
+	: public IStreamingHashDecoder<typename Search::Evaluator::ChannelSymbol>
+{
+public:
+	typedef typename Search::Evaluator::ChannelSymbol ChannelSymbol;
+	typedef typename Search::Evaluator::SymbolStorage SymbolStorage;
+	typedef typename Search::BranchData BranchData;
+
+	/**
+	 * C'tor
+	 *
+	 * @param spineLength: number of spine values in the spine
+	 * @param commitDistance: the number of spine values the search advances
+	 *     past a spine value before committing its block
+	 * @param maxNumSymbolsPerValue: the maximum number of symbols we'll have
+	 * 		to store for all spine values except the last one
+	 * @param maxNumSymbolsLastValue: the maximum number of symbols we'll have
+	 * 		to store for the last spine value.
+	 * @param search: the search, with a maximum depth of at least
+	 *     min(commitDistance + 1, spineLength)
+	 */
+	StreamingHashDecoder(unsigned int spineLength,
+						 unsigned int commitDistance,
+						 unsigned int maxNumSymbolsPerValue,
+						 unsigned int maxNumSymbolsLastValue,
+						 const Search& search);
+
+	/**
+	 * Virtual d'tor
+	 */
+	virtual ~StreamingHashDecoder() {}
+
+	/**
+	 * Resets the decoder, so a different message can be decoded
+	 */
+	virtual void reset();
+
+	/**
+	 * Sets the callback that receives committed blocks
+	 */
+	virtual void setCallback(IStreamingDecodeCallback::Ptr callback);
+
+	/**
+	 * Adds symbols (see IStreamingHashDecoder::add)
+	 */
+	virtual void add(const std::vector<unsigned int>& spineValueIndices,
+					 const std::vector<ChannelSymbol>& symbols,
+					 N0_t n0);
+
+	/**
+	 * Advances to the end of the spine and commits the remaining blocks
+	 */
+	virtual void finish();
+
+	/**
+	 * @return the number of blocks committed since reset()
+	 */
+	virtual unsigned int numCommitted();
+
+	/**
+	 * Moves committed blocks that were not passed to a callback into 'blocks'
+	 */
+	virtual void takeBlocks(std::vector<unsigned short>& blocks);
+
+private:
+	/**
+	 * Advances the search over the front spine value, with the symbols in
+	 *     storage, and commits the blocks that are far enough behind it
+	 */
+	void advanceFront();
+
+	/**
+	 * Commits the best path's blocks up to 'numCommitted' blocks
+	 */
+	void commit(unsigned int numCommitted);
+
+	/**
+	 * Passes the blocks committed since the last call to the callback
+	 */
+	void notify();
+
+	// The number of coding steps
+	const unsigned int m_spineLength;
+
+	// The number of spine values between the front and committed blocks
+	const unsigned int m_commitDistance;
+
+	// Instance to perform beam search
+	Search m_search;
+
+	// Symbols of the front spine value, stored as spine value 0
+	SymbolStorage m_storage;
+
+	// The spine value that is collecting symbols; the search has advanced
+	// over all spine values before it
+	unsigned int m_front;
+
+	// The number of blocks committed since reset()
+	unsigned int m_numCommitted;
+
+	// Receives committed blocks, if set
+	IStreamingDecodeCallback::Ptr m_callback;
+
+	// Committed blocks that were not passed to the callback yet, starting
+	// with block m_firstPendingBlock
+	std::vector<unsigned short> m_pendingBlocks;
+	unsigned int m_firstPendingBlock;
+
+	// Buffer for the best path's uncommitted blocks
+	std::vector<unsigned short> m_path;
+};
+
+// include implementation
+#include "StreamingHashDecoder.hh"
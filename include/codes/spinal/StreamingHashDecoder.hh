@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+template<typename Search>
+StreamingHashDecoder<Search>::StreamingHashDecoder(
+		unsigned int spineLength,
+		unsigned int commitDistance,
+		unsigned int maxNumSymbolsPerValue,
+		unsigned int maxNumSymbolsLastValue,
+		const Search& search)
+	: m_spineLength(spineLength),
+	  m_commitDistance(commitDistance),
+	  m_search(search),
+	  m_storage(m_search.branchEvaluator().symbolStorage(
+			  	1,
+			  	std::max(maxNumSymbolsPerValue, maxNumSymbolsLastValue),
+			  	std::max(maxNumSymbolsPerValue, maxNumSymbolsLastValue))),
+	  m_front(0),
+	  m_numCommitted(0),
+	  m_firstPendingBlock(0)
+{
+	if(spineLength < 1) {
+		throw(std::runtime_error("Spine length has to be positive"));
+	}
+
+	reset();
+}
+
+template<typename Search>
+inline void StreamingHashDecoder<Search>::reset()
+{
+	m_search.initialize();
+	m_search.getRoot().hash = 0;
+	m_search.getRoot().likelihood = 0;
+
+	m_storage.reset();
+
+	m_front = 0;
+	m_numCommitted = 0;
+	m_pendingBlocks.clear();
+	m_firstPendingBlock = 0;
+}
+
+template<typename Search>
+inline void StreamingHashDecoder<Search>::setCallback(
+		IStreamingDecodeCallback::Ptr callback)
+{
+	m_callback = callback;
+}
+
+template<typename Search>
+inline void StreamingHashDecoder<Search>::add(
+		const std::vector<unsigned int>& spineValueIndices,
+		const std::vector<ChannelSymbol>& symbols,
+		N0_t n0)
+{
+	unsigned int numSymbols = spineValueIndices.size();
+
+	for(unsigned int i = 0; i < numSymbols; i++) {
+		unsigned int spineIndex = spineValueIndices[i];
+
+		if(spineIndex < m_front) {
+			throw(std::runtime_error("Symbols must be added in spine order"));
+		}
+		if(spineIndex >= m_spineLength) {
+			throw(std::runtime_error("Spine value index out of range"));
+		}
+
+		// The search is done with all symbols of earlier spine values
+		while(m_front < spineIndex) {
+			advanceFront();
+		}
+
+		m_storage.add(0, symbols[i]);
+	}
+
+	notify();
+}
+
+template<typename Search>
+inline void StreamingHashDecoder<Search>::finish()
+{
+	while(m_front < m_spineLength) {
+		advanceFront();
+	}
+
+	commit(m_spineLength);
+	notify();
+}
+
+template<typename Search>
+inline unsigned int StreamingHashDecoder<Search>::numCommitted()
+{
+	return m_numCommitted;
+}
+
+template<typename Search>
+inline void StreamingHashDecoder<Search>::takeBlocks(
+		std::vector<unsigned short>& blocks)
+{
+	blocks.clear();
+	blocks.swap(m_pendingBlocks);
+	m_firstPendingBlock += blocks.size();
+}
+
+template<typename Search>
+inline void StreamingHashDecoder<Search>::advanceFront()
+{
+	BranchData symbols(m_storage, 0);
+	m_search.advance(symbols);
+
+	// The storage is reused for the next spine value
+	m_storage.reset();
+	m_front++;
+
+	if(m_front > m_commitDistance) {
+		commit(m_front - m_commitDistance);
+	}
+}
+
+template<typename Search>
+inline void StreamingHashDecoder<Search>::commit(unsigned int numCommitted)
+{
+	if(numCommitted <= m_numCommitted) {
+		return;
+	}
+
+	// Blocks of the best path, from the first uncommitted spine value
+	m_search.getBestPath(m_path, m_numCommitted);
+
+	m_pendingBlocks.insert(m_pendingBlocks.end(),
+						   m_path.begin(),
+						   m_path.begin() + (numCommitted - m_numCommitted));
+	m_numCommitted = numCommitted;
+}
+
+template<typename Search>
+inline void StreamingHashDecoder<Search>::notify()
+{
+	if((!m_callback) || m_pendingBlocks.empty()) {
+		return;
+	}
+
+	m_callback->onBlocks(m_firstPendingBlock, m_pendingBlocks);
+	m_firstPendingBlock += m_pendingBlocks.size();
+	m_pendingBlocks.clear();
+}
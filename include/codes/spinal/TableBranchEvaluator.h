@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "../../util/SizedArray.h"
+#include "SpinalBranchEvaluator.h"
+#include "DistanceTableStorage.h"
+#include "SpineValueCache.h"
+
+/**
+ * \ingroup spinal
+ * \brief Evaluates likelihoods of branches in the decoding tree, by looking
+ *    up distances in tables of the received symbols.
+ *
+ * Gives the same likelihoods as a SpinalBranchEvaluator with the same mapper
+ *    and distance, for mappers whose output depends on the numInputBits LSBs
+ *    of their input, and that map every input to one output symbol. The
+ *    decoder's DistanceTableStorage computes the distance from each received
+ *    symbol to every possible candidate symbol, so evaluating a branch only
+ *    hashes, masks the encoded symbols and adds the table entries; the mapper
+ *    and the distance function are not called while branching.
+ *
+ * When FIXED_K is non-zero, k is fixed at compile time, as in
+ *    SpinalBranchEvaluator. Weights are renormalized if the distance needs it,
+ *    also as in SpinalBranchEvaluator.
+ */
+template<typename SpineValueType,
+		 typename Mapper,
+		 typename Distance,
+		 unsigned int FIXED_K = 0>
+class TableBranchEvaluator {
+private:
+	// The number of children if fixed at compile time, 0 otherwise
+	enum { FIXED_NUM_CHILDREN = (FIXED_K == 0) ? 0 : (1 << FIXED_K) };
+
+public:
+	typedef typename Distance::Weight Weight;
+	typedef typename Mapper::OutputType ChannelSymbol;
+
+	typedef SpinalNode<typename SpineValueType::Seed, Weight> Node;
+	typedef DistanceTableCollection<Weight> BranchData;
+	typedef DistanceTableStorage<Mapper, Distance> SymbolStorage;
+
+	enum { RENORMALIZE_WEIGHTS = RenormalizesWeights<Distance>::value };
+
+	/**
+	 * C'tor
+	 *
+	 * @param mapper: the mapper from encoder output to symbols
+	 * @param numInputBits: the number of bits of encoder output the mapper
+	 *     uses
+	 * @param k: the size of k for the code
+	 * @param distance: the distance between symbols, used to make tables
+	 */
+	TableBranchEvaluator(const Mapper& mapper,
+						 unsigned int numInputBits,
+						 uint32_t k,
+						 const Distance& distance = Distance());
+
+	/**
+	 * The same evaluator with k fixed at compile time
+	 */
+	template<unsigned int K>
+	struct WithFixedK {
+		typedef TableBranchEvaluator<SpineValueType, Mapper, Distance, K> Type;
+
+		static Type convert(const TableBranchEvaluator& evaluator) {
+			return Type(evaluator.mapper(),
+						evaluator.numInputBits(),
+						evaluator.k(),
+						evaluator.distance());
+		}
+	};
+
+	/**
+	 * @return the mapper from encoder output to symbols
+	 */
+	const Mapper& mapper() const;
+
+	/**
+	 * @return the number of bits of encoder output the mapper uses
+	 */
+	unsigned int numInputBits() const;
+
+	/**
+	 * @return the size of k for the code
+	 */
+	uint32_t k() const;
+
+	/**
+	 * @return the distance between symbols
+	 */
+	const Distance& distance() const;
+
+	/**
+	 * @return the cache of spine values, @see SpinalBranchEvaluator
+	 */
+	SpineValueCache<SpineValueType>& spineValueCache();
+
+	/**
+	 * Makes the storage where a decoder keeps the distance tables of the
+	 *    symbols it receives.
+	 *
+	 * Tables grow as symbols arrive, so the maximal numbers of symbols are
+	 *    not needed.
+	 */
+	SymbolStorage symbolStorage(unsigned int spineLength,
+								unsigned int maxNumSymbolsPerValue,
+								unsigned int maxNumSymbolsLastValue) const;
+
+	/**
+	 * Advances the spine from 'parent', using 'edge' as input message bits. The
+	 *    resulting decode information is stored in 'child'
+	 *
+	 * @note implementation MUST behave correctly when parent and child are
+	 *    the same object.
+	 */
+	void branch(Node& parent,
+				unsigned int edge,
+				BranchData& tables,
+				Node& child);
+
+	/**
+	 * Advances the spine from 'parent' along all 2^k edges. The child reached
+	 *    with edge 'e' is stored in children[e].
+	 *
+	 * Symbol i of all children is generated together, and their distances
+	 *    looked up in table i side by side.
+	 *
+	 * @note children must not contain parent.
+	 */
+	void branchAll(Node& parent,
+				   BranchData& tables,
+				   Node* children);
+
+	/**
+	 * Initializes Node objects for the first time (does nothing).
+	 */
+	void initNode(Node& node);
+
+	/**
+	 * Subtracts 'offset' from the node's path weight. Only used when
+	 *     RENORMALIZE_WEIGHTS is set.
+	 */
+	void renormalize(Node& node, Weight offset);
+
+private:
+	/**
+	 * @return the number of children of each node, 2^k
+	 */
+	unsigned int numChildren() const {
+		return (FIXED_K != 0) ? (unsigned int)FIXED_NUM_CHILDREN : m_numChildren;
+	}
+
+	// K for each of the decoders
+	const uint32_t m_k;
+
+	// Number of children of each node, 2^k
+	const uint32_t m_numChildren;
+
+	// The mapper, used to make distance tables
+	Mapper m_mapper;
+
+	// The distance, used to make distance tables
+	Distance m_distance;
+
+	// Spine values from previous branches, if enabled
+	SpineValueCache<SpineValueType> m_cache;
+
+	// Number of bits of encoder output the mapper uses
+	const unsigned int m_numInputBits;
+
+	// Mask to extract a table index from encoder output
+	const uint16_t m_inputMask;
+
+	// The number of entries in each distance table
+	const unsigned int m_tableSize;
+
+	// The likelihood of the last step for each child, in branchAll()
+	SizedArray<Weight, FIXED_NUM_CHILDREN> m_stepLikelihoods;
+
+	// Inputs to batch hashing in branchAll(): the parent's seed for every
+	// child, and the edge leading to every child
+	SizedArray<typename SpineValueType::Seed, FIXED_NUM_CHILDREN> m_parentSeeds;
+	SizedArray<uint32_t, FIXED_NUM_CHILDREN> m_edges;
+
+	// The children's seeds, when taken from the cache in branchAll()
+	SizedArray<typename SpineValueType::Seed, FIXED_NUM_CHILDREN> m_childSeeds;
+
+	// The children's spine values in branchAll(), and pointers to them
+	SizedArray<SpineValueType, FIXED_NUM_CHILDREN> m_childSpineValues;
+	SizedArray<SpineValueType*, FIXED_NUM_CHILDREN> m_childSpineValuePtrs;
+
+	// One encoded symbol of every child, in branchAll()
+	SizedArray<uint16_t, FIXED_NUM_CHILDREN> m_encodedSymbols;
+
+	// Encoded symbols taken from the cache. In branchAll(), symbol i of child
+	// e is in entry (i * numChildren + e).
+	std::vector<uint16_t> m_cachedSymbols;
+};
+
+
+// IMPLEMENTATION
+
+#include <algorithm>
+#include <stdexcept>
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>
+	::TableBranchEvaluator(const Mapper& mapper,
+						   unsigned int numInputBits,
+						   uint32_t k,
+						   const Distance& distance)
+	 : m_k(k),
+	   m_numChildren(1 << m_k),
+	   m_mapper(mapper),
+	   m_distance(distance),
+	   m_numInputBits(numInputBits),
+	   m_inputMask((1 << m_numInputBits) - 1),
+	   m_tableSize(1 << m_numInputBits),
+	   m_stepLikelihoods(m_numChildren),
+	   m_parentSeeds(m_numChildren),
+	   m_edges(m_numChildren),
+	   m_childSeeds(m_numChildren),
+	   m_childSpineValues(m_numChildren),
+	   m_childSpineValuePtrs(m_numChildren),
+	   m_encodedSymbols(m_numChildren)
+{
+	if((FIXED_K != 0) && (m_k != FIXED_K)) {
+		throw(std::runtime_error("k does not match the evaluator's fixed k"));
+	}
+
+	if(m_numInputBits > 16) {
+		throw(std::runtime_error("Mapper input too big for distance tables, max 16 bits"));
+	}
+
+	for(unsigned int edge = 0; edge < m_numChildren; edge++) {
+		m_edges[edge] = edge;
+	}
+}
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline const Mapper&
+TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>::mapper() const
+{
+	return m_mapper;
+}
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline unsigned int
+TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>::numInputBits() const
+{
+	return m_numInputBits;
+}
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline uint32_t TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>::k() const
+{
+	return m_k;
+}
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline const Distance&
+TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>::distance() const
+{
+	return m_distance;
+}
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline SpineValueCache<SpineValueType>&
+TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>::spineValueCache()
+{
+	return m_cache;
+}
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline typename TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>::SymbolStorage
+TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>::symbolStorage(
+		unsigned int spineLength,
+		unsigned int, // unused
+		unsigned int) const // unused
+{
+	return SymbolStorage(spineLength, m_mapper, m_numInputBits, m_distance);
+}
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline void TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>
+	::branch(Node & parent, unsigned int edge, BranchData& tables, Node & child)
+{
+	// The likelihood due to this step
+	Weight stepLikelihood = 0;
+
+	// Look up each encoded symbol's distance in its symbol's table
+	const Weight* table = tables.tables;
+
+	if(m_cache.isEnabled()) {
+		m_cachedSymbols.resize(tables.size);
+		child.hash = m_cache.generate(
+				parent.hash,
+				edge,
+				tables.size,
+				(tables.size > 0) ? &m_cachedSymbols[0] : NULL,
+				1);
+
+		for(unsigned int i = 0; i < tables.size; i++) {
+			stepLikelihood = WeightTraits<Weight>::add(
+					stepLikelihood,
+					table[m_cachedSymbols[i] & m_inputMask]);
+			table += m_tableSize;
+		}
+	} else {
+		// generate the next spine value from the bits
+		SpineValueType spineValue(parent.hash, edge);
+		child.hash = spineValue.getSeed();
+
+		for(unsigned int i = 0; i < tables.size; i++) {
+			stepLikelihood = WeightTraits<Weight>::add(
+					stepLikelihood,
+					table[spineValue.next() & m_inputMask]);
+			table += m_tableSize;
+		}
+	}
+
+	child.lastCodeStepLikelihood = stepLikelihood;
+	child.likelihood = WeightTraits<Weight>::add(parent.likelihood, stepLikelihood);
+}
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline void TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>
+	::branchAll(Node & parent, BranchData& tables, Node* children)
+{
+	const unsigned int numChildren = this->numChildren();
+	const bool cached = m_cache.isEnabled();
+
+	if(cached) {
+		// All symbols of all children are copied from the cache, interleaved
+		m_cachedSymbols.resize(tables.size * numChildren);
+		m_cache.generateChildren(
+				parent.hash,
+				numChildren,
+				tables.size,
+				(tables.size > 0) ? &m_cachedSymbols[0] : NULL,
+				&m_childSeeds[0]);
+
+		for(unsigned int edge = 0; edge < numChildren; edge++) {
+			children[edge].hash = m_childSeeds[edge];
+		}
+	} else {
+		// generate all children's spine values together
+		std::fill(m_parentSeeds.begin(), m_parentSeeds.end(), parent.hash);
+		SpineValueType::hashBatch(&m_parentSeeds[0],
+								  &m_edges[0],
+								  numChildren,
+								  &m_childSpineValues[0]);
+
+		for(unsigned int edge = 0; edge < numChildren; edge++) {
+			children[edge].hash = m_childSpineValues[edge].getSeed();
+
+			// Pointers are set here, since a copied evaluator would otherwise
+			// point to the original's spine values
+			m_childSpineValuePtrs[edge] = &m_childSpineValues[edge];
+		}
+	}
+
+	// Accumulate distances. Every child sums its symbols in the same order as
+	// branch() does, so the results are identical.
+	Weight* stepLikelihoods = &m_stepLikelihoods[0];
+	uint16_t* encoded = &m_encodedSymbols[0];
+	std::fill(stepLikelihoods, stepLikelihoods + numChildren, Weight(0));
+
+	const Weight* table = tables.tables;
+	for(unsigned int i = 0; i < tables.size; i++) {
+		if(cached) {
+			encoded = &m_cachedSymbols[i * numChildren];
+		} else {
+			SpineValueType::nextBatch(&m_childSpineValuePtrs[0],
+									  numChildren,
+									  encoded);
+		}
+
+		for(unsigned int edge = 0; edge < numChildren; edge++) {
+			stepLikelihoods[edge] = WeightTraits<Weight>::add(
+					stepLikelihoods[edge],
+					table[encoded[edge] & m_inputMask]);
+		}
+		table += m_tableSize;
+	}
+
+	for(unsigned int edge = 0; edge < numChildren; edge++) {
+		children[edge].lastCodeStepLikelihood = stepLikelihoods[edge];
+		children[edge].likelihood = WeightTraits<Weight>::add(parent.likelihood,
+															  stepLikelihoods[edge]);
+	}
+}
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline void TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>::initNode(Node & node)
+{// We don't have to do anything in this case.
+}
+
+template<typename SpineValueType, typename Mapper, typename Distance, unsigned int FIXED_K>
+inline void TableBranchEvaluator<SpineValueType,Mapper,Distance,FIXED_K>
+	::renormalize(Node & node, Weight offset)
+{
+	node.likelihood -= offset;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <vector>
+#include <stdexcept>
+
+/**
+ * \ingroup util
+ * \brief An array whose size is either fixed at compile time, or given at
+ *    construction.
+ *
+ * When SIZE is non-zero, the elements are stored inside the object and size()
+ *    is a compile-time constant, so loops over the array can be unrolled. When
+ *    SIZE is 0, the elements are stored in a std::vector, with the size given
+ *    to the constructor.
+ */
+template<typename T, unsigned int SIZE>
+class SizedArray {
+public:
+	/**
+	 * C'tor
+	 * @param size: the number of elements. Must equal SIZE.
+	 */
+	SizedArray(unsigned int size) {
+		if(size != SIZE) {
+			throw(std::runtime_error("SizedArray size does not match its fixed size"));
+		}
+	}
+
+	unsigned int size() const { return SIZE; }
+
+	T& operator[](unsigned int i) { return m_data[i]; }
+	const T& operator[](unsigned int i) const { return m_data[i]; }
+
+	T* begin() { return m_data; }
+	T* end() { return m_data + SIZE; }
+
+private:
+	T m_data[SIZE];
+};
+
+/**
+ * \ingroup util
+ * \brief SizedArray with its size given at construction
+ */
+template<typename T>
+class SizedArray<T, 0> {
+public:
+	SizedArray(unsigned int size) : m_data(size) {}
+
+	unsigned int size() const { return m_data.size(); }
+
+	T& operator[](unsigned int i) { return m_data[i]; }
+	const T& operator[](unsigned int i) const { return m_data[i]; }
+
+	T* begin() { return &m_data[0]; }
+	T* end() { return &m_data[0] + m_data.size(); }
+
+private:
+	std::vector<T> m_data;
+};
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <pthread.h>
+#include <vector>
+
+/**
+ * \ingroup util
+ * \brief A task that is run concurrently by all workers of a WorkerPool
+ */
+class IWorkerTask {
+public:
+	virtual ~IWorkerTask() {}
+
+	/**
+	 * Performs the part of the task belonging to a worker
+	 * @param workerIndex: the index of the worker, 0..numWorkers-1
+	 */
+	virtual void work(unsigned int workerIndex) = 0;
+};
+
+/**
+ * \ingroup util
+ * \brief A fixed set of threads that run tasks together.
+ *
+ * The threads are created once, in the constructor, and wait for tasks. The
+ *    thread calling run() acts as worker 0, so a pool of size 1 does not
+ *    create any threads.
+ */
+class WorkerPool {
+public:
+	/**
+	 * C'tor
+	 * @param numWorkers: the number of workers, including the calling thread
+	 */
+	WorkerPool(unsigned int numWorkers);
+
+	/**
+	 * D'tor. Stops and joins all threads.
+	 */
+	~WorkerPool();
+
+	/**
+	 * @return the number of workers, including the calling thread
+	 */
+	unsigned int size();
+
+	/**
+	 * Runs task.work(i) on every worker i, and returns when all workers are
+	 *    done.
+	 */
+	void run(IWorkerTask& task);
+
+private:
+	// Not copyable: threads belong to a single pool
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+
+	// Arguments for each thread's main function
+	struct ThreadContext {
+		WorkerPool* pool;
+		unsigned int workerIndex;
+	};
+
+	/**
+	 * Main function of the worker threads
+	 */
+	static void* threadMain(void* context);
+
+	/**
+	 * Waits for tasks and runs them, until the pool is destroyed
+	 */
+	void serve(unsigned int workerIndex);
+
+	// The number of workers, including the calling thread
+	const unsigned int m_numWorkers;
+
+	// Threads for workers 1..m_numWorkers-1
+	std::vector<pthread_t> m_threads;
+	std::vector<ThreadContext> m_contexts;
+
+	// Protects all members below
+	pthread_mutex_t m_mutex;
+
+	// Signaled when a new task is available, or the pool is shutting down
+	pthread_cond_t m_taskCond;
+
+	// Signaled when the last thread finished its part of a task
+	pthread_cond_t m_doneCond;
+
+	// The current task
+	IWorkerTask* m_task;
+
+	// Incremented with every task, so threads can tell a new task arrived
+	unsigned int m_generation;
+
+	// The number of threads still working on the current task
+	unsigned int m_numBusy;
+
+	// True when threads should exit
+	bool m_shutdown;
+};
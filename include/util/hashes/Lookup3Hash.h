@@ -7,6 +7,7 @@
 #include <vector>
 #include <stdint.h>
 #include "UnlimitedHash.h"
+#include "PackedSymbolFunction.h"
 
 /**
  * \ingroup hashes
@@ -46,4 +47,21 @@ public:
 
 };
 
+#ifndef SWIG
+/**
+ * \ingroup hashes
+ * \brief PackedSymbolFunction takes the two words lookup3 outputs, c and b
+ *     (see digest_extended()). The first word is the one
+ *     Lookup3SymbolFunction uses.
+ */
+template<>
+struct SymbolStateWords<Lookup3Hash> {
+	enum { NUM_WORDS = 2 };
+
+	static uint32_t word(const Lookup3Hash::State& state, unsigned int i) {
+		return state[2 - i];
+	}
+};
+#endif
+
 typedef UnlimitedHash<Lookup3SymbolFunction> Lookup3UnlimitedHash;
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * \ingroup hashes
+ * \brief The words of a hash's state that are random enough to produce
+ *     symbols.
+ *
+ * Hashes that support PackedSymbolFunction specialize this template with
+ *     enum { NUM_WORDS = ... };
+ *     static uint32_t word(const Hash::State& state, unsigned int i);
+ */
+template<typename HashFunctionT>
+struct SymbolStateWords;
+
+/**
+ * \ingroup hashes
+ * \brief Packs SYMBOL_BITS-bit symbols out of the words of a hash state
+ *
+ * Mappers only use the low c bits of every symbol, so instead of one 16-bit
+ *     symbol per half-word, the state's bits are cut into as many
+ *     SYMBOL_BITS-bit symbols as they hold. Each state then yields
+ *     (32 * NUM_WORDS) / SYMBOL_BITS symbols, and UnlimitedHash re-derives its
+ *     state that much less often.
+ *
+ * Only the low SYMBOL_BITS bits of a symbol are set, so the code must be used
+ *     with a mapper that takes at most SYMBOL_BITS bits from each symbol. The
+ *     symbols differ from those of the hash's default symbol function, hence
+ *     encoder and decoder have to use the same symbol function.
+ */
+template<typename HashFunctionT, unsigned int SYMBOL_BITS>
+class PackedSymbolFunction{
+public:
+	typedef HashFunctionT Hash;
+	static const unsigned int NUM_SYMBOLS_PER_STATE =
+			(32 * SymbolStateWords<HashFunctionT>::NUM_WORDS) / SYMBOL_BITS;
+
+	static void getSymbols(const typename Hash::State& state,
+	                       uint16_t* symbols);
+};
+
+
+template<typename HashFunctionT, unsigned int SYMBOL_BITS>
+inline void PackedSymbolFunction<HashFunctionT, SYMBOL_BITS>::getSymbols(
+		const typename Hash::State & state,
+		uint16_t* symbols)
+{
+	typedef SymbolStateWords<HashFunctionT> Words;
+
+	// Bits of the state that were not output yet, from the lsb. There are
+	// fewer than SYMBOL_BITS <= 16 bits left before a word is added, so the
+	// window never holds more than 47 bits.
+	uint64_t window = 0;
+	unsigned int numWindowBits = 0;
+	unsigned int nextWord = 0;
+
+	for(unsigned int i = 0; i < NUM_SYMBOLS_PER_STATE; i++) {
+		if(numWindowBits < SYMBOL_BITS) {
+			window |= uint64_t(Words::word(state, nextWord++)) << numWindowBits;
+			numWindowBits += 32;
+		}
+
+		symbols[i] = window & ((1 << SYMBOL_BITS) - 1);
+		window >>= SYMBOL_BITS;
+		numWindowBits -= SYMBOL_BITS;
+	}
+}
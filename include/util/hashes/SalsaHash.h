@@ -7,6 +7,7 @@
 #include "salsa20.h"
 #include <stdint.h>
 #include "UnlimitedHash.h"
+#include "PackedSymbolFunction.h"
 
 class SalsaHash {
 public:
@@ -36,4 +37,35 @@ public:
 	                       uint16_t* symbols);
 };
 
+#ifndef SWIG
+/**
+ * \ingroup hashes
+ * \brief PackedSymbolFunction takes all 16 words of a Salsa state, in the
+ *     order SalsaSymbolFunction uses them
+ */
+template<>
+struct SymbolStateWords<SalsaHash> {
+	enum { NUM_WORDS = 16 };
+
+	static uint32_t word(const SalsaHash::State& state, unsigned int i) {
+		return state[15 - i];
+	}
+};
+
+/**
+ * \ingroup hashes
+ * \brief Computes several Salsa states together, in SIMD lanes
+ */
+template<>
+struct HashBatch<SalsaHash> {
+	static void hash(const SalsaHash::Digest* digests,
+					 const uint32_t* data,
+					 unsigned int n,
+					 SalsaHash::State* states)
+	{
+		salsaHashBatch(digests, data, n, states);
+	}
+};
+#endif
+
 typedef UnlimitedHash<SalsaSymbolFunction> SalsaUnlimitedHash;
@@ -5,9 +5,28 @@
 #pragma once
 
 #include <stdint.h>
+#include <algorithm>
 
 using namespace std;
 
+/**
+ * \ingroup hashes
+ * \brief Computes the states of several independent hashes together.
+ *
+ * The generic implementation hashes the inputs one after the other. Hashes
+ *    that can compute several states at once specialize this template.
+ */
+template<typename Hash>
+struct HashBatch {
+	/**
+	 * Sets states[i] to the state of hashing data[i] with digests[i]
+	 */
+	static void hash(const typename Hash::Digest* digests,
+					 const uint32_t* data,
+					 unsigned int n,
+					 typename Hash::State* states);
+};
+
 /**
  * \ingroup hashes
  * \brief A hash function that produces a pseudo-random stream of 16-bit values.
@@ -32,6 +51,30 @@ public:
 	 **/
 	UnlimitedHash(const Seed prevSeed, uint32_t data);
 
+	/**
+	 * Default c'tor, for arrays of hashes. The hash must be set with
+	 *     hashBatch() before use.
+	 */
+	UnlimitedHash();
+
+	/**
+	 * Hashes 'n' independent (prevSeed, data) pairs together. Equivalent to
+	 *     out[i] = UnlimitedHash(prevSeeds[i], data[i]) for every i, but
+	 *     faster for hashes with a batch implementation.
+	 */
+	static void hashBatch(const Seed* prevSeeds,
+						  const uint32_t* data,
+						  unsigned int n,
+						  UnlimitedHash* out);
+
+	/**
+	 * Gets the next 16 bits from each of 'n' hashes: out[i] = hashes[i]->next().
+	 *     Hashes that ran out of symbols are re-derived together.
+	 */
+	static void nextBatch(UnlimitedHash** hashes,
+						  unsigned int n,
+						  uint16_t* out);
+
 	/**
 	 * Evaluates $h$ on the previous spine and input data.
 	 * Sets the f index to the first f (symbolInd = 0)
@@ -51,6 +94,18 @@ public:
 	uint16_t next();
 
 private:
+	// The maximal number of states hashed together in hashBatch and nextBatch
+	static const unsigned int BATCH_SIZE = 16;
+
+	/**
+	 * Sets the seed and symbols from a newly hashed state
+	 */
+	void setHashState(const typename Hash::State& hashState);
+
+	/**
+	 * Sets the symbols from a re-derived state
+	 */
+	void setDerivedState(const typename Hash::State& hashState);
 
 	// The previous spine
 	Seed m_seed;
@@ -9,6 +9,21 @@
 #define INITIAL_STATE_VERSION (3610617884)
 #define STATE_VERSION_INCREMENT (3243335647)
 
+template<typename Hash>
+inline void HashBatch<Hash>::hash(const typename Hash::Digest* digests,
+								  const uint32_t* data,
+								  unsigned int n,
+								  typename Hash::State* states)
+{
+	for(unsigned int i = 0; i < n; i++) {
+		Hash::init(digests[i], states[i]);
+		Hash::update(states[i], data[i]);
+	}
+}
+
+template<typename SymbolFunction>
+const unsigned int UnlimitedHash<SymbolFunction>::BATCH_SIZE;
+
 template<typename SymbolFunction>
 inline UnlimitedHash<SymbolFunction>::UnlimitedHash(
 		const Seed prevSeed,
@@ -18,6 +33,76 @@ inline UnlimitedHash<SymbolFunction>::UnlimitedHash(
 	hash(data);
 }
 
+template<typename SymbolFunction>
+inline UnlimitedHash<SymbolFunction>::UnlimitedHash()
+  : m_seed(0),
+    m_stateDerivationVersion(INITIAL_STATE_VERSION),
+    m_numRemainingSymbols(0)
+{}
+
+template<typename SymbolFunction>
+inline void UnlimitedHash<SymbolFunction>::hashBatch(
+		const Seed* prevSeeds,
+		const uint32_t* data,
+		unsigned int n,
+		UnlimitedHash* out)
+{
+	typename Hash::State hashStates[BATCH_SIZE];
+
+	for(unsigned int first = 0; first < n; first += BATCH_SIZE) {
+		unsigned int numHashes = std::min(BATCH_SIZE, n - first);
+
+		HashBatch<Hash>::hash(prevSeeds + first,
+							  data + first,
+							  numHashes,
+							  hashStates);
+
+		for(unsigned int i = 0; i < numHashes; i++) {
+			out[first + i].setHashState(hashStates[i]);
+		}
+	}
+}
+
+template<typename SymbolFunction>
+inline void UnlimitedHash<SymbolFunction>::nextBatch(
+		UnlimitedHash** hashes,
+		unsigned int n,
+		uint16_t* out)
+{
+	Seed seeds[BATCH_SIZE];
+	uint32_t versions[BATCH_SIZE];
+	UnlimitedHash* derived[BATCH_SIZE];
+	typename Hash::State hashStates[BATCH_SIZE];
+
+	for(unsigned int first = 0; first < n; first += BATCH_SIZE) {
+		unsigned int numHashes = std::min(BATCH_SIZE, n - first);
+
+		// Find hashes that need to be re-derived
+		unsigned int numDerived = 0;
+		for(unsigned int i = 0; i < numHashes; i++) {
+			UnlimitedHash* h = hashes[first + i];
+			if(h->m_numRemainingSymbols == 0) {
+				seeds[numDerived] = h->m_seed;
+				versions[numDerived] = h->m_stateDerivationVersion;
+				derived[numDerived] = h;
+				numDerived++;
+			}
+		}
+
+		if(numDerived > 0) {
+			HashBatch<Hash>::hash(seeds, versions, numDerived, hashStates);
+			for(unsigned int i = 0; i < numDerived; i++) {
+				derived[i]->setDerivedState(hashStates[i]);
+			}
+		}
+
+		for(unsigned int i = 0; i < numHashes; i++) {
+			UnlimitedHash* h = hashes[first + i];
+			out[first + i] = h->m_nextSymbols[--h->m_numRemainingSymbols];
+		}
+	}
+}
+
 template<typename SymbolFunction>
 inline void UnlimitedHash<SymbolFunction>::hash(unsigned int data)
 {
@@ -26,6 +111,13 @@ inline void UnlimitedHash<SymbolFunction>::hash(unsigned int data)
 	Hash::init(m_seed, hashState);
 	Hash::update(hashState, data);
 
+	setHashState(hashState);
+}
+
+template<typename SymbolFunction>
+inline void UnlimitedHash<SymbolFunction>::setHashState(
+		const typename Hash::State& hashState)
+{
 	// Update internal seed with new seed
 	m_seed = Hash::digest(hashState);
 
@@ -56,14 +148,21 @@ inline uint16_t UnlimitedHash<SymbolFunction>::next()
 		Hash::init(m_seed, hashState);
 		Hash::update(hashState, m_stateDerivationVersion);
 
-		// Get symbols from the state to array, update number available symbols
-		SymbolFunction::getSymbols(hashState, m_nextSymbols);
-		m_numRemainingSymbols = SymbolFunction::NUM_SYMBOLS_PER_STATE;
-
-		// Update the state derivation version, so next time we'll get more
-		// pseudo-random symbols.
-		m_stateDerivationVersion += STATE_VERSION_INCREMENT;
+		setDerivedState(hashState);
 	}
 
 	return m_nextSymbols[--m_numRemainingSymbols];
 }
+
+template<typename SymbolFunction>
+inline void UnlimitedHash<SymbolFunction>::setDerivedState(
+		const typename Hash::State& hashState)
+{
+	// Get symbols from the state to array, update number available symbols
+	SymbolFunction::getSymbols(hashState, m_nextSymbols);
+	m_numRemainingSymbols = SymbolFunction::NUM_SYMBOLS_PER_STATE;
+
+	// Update the state derivation version, so next time we'll get more
+	// pseudo-random symbols.
+	m_stateDerivationVersion += STATE_VERSION_INCREMENT;
+}
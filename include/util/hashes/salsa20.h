@@ -19,3 +19,20 @@ SalsaDigest salsaDigest(const SalsaState& state);
 int salsaGetSymbol(const SalsaState& hashState,
 					unsigned int symbolSizeBits,
 					unsigned int pointIndex);
+
+/**
+ * Computes the states of 'n' independent hashes: states[i] is the state
+ *    salsaInit(digests[i]) followed by salsaUpdate(data[i]) would produce.
+ *
+ * Several states are computed together in SIMD lanes, using the widest
+ *    instruction set (SSE2, AVX2 or AVX-512) that the CPU supports.
+ */
+void salsaHashBatch(const SalsaDigest* digests,
+					const u32* data,
+					unsigned int n,
+					SalsaState* states);
+
+/**
+ * @return the name of the implementation salsaHashBatch uses on this CPU
+ */
+const char* salsaBatchImplementationName();
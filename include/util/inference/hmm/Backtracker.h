@@ -6,6 +6,8 @@
 
 #include <vector>
 #include <algorithm>
+#include <stdexcept>
+#include <stdint.h>
 
 /**
  * \ingroup hmm
@@ -21,17 +23,38 @@
  *    the layer, (i) its parent in the previous layer and (ii) the label of the
  *    edge from the parent.
  *
- * An instance is able to handle up to 'depth' layers. Each layer has up to
- * 	  'width' nodes. The edge information is up to 'edgeNumBits' bits long. The
- * 	  backtracker will encode the nodes' information in a compact structure,
- * 	  to try to minimize writes to memory.
+ * An instance keeps up to 'depth' layers. Each layer has up to
+ * 	  'width' nodes. The edge information is up to 'edgeNumBits' bits long.
+ * 	  Node information is bit-packed: each node takes just enough bits for
+ * 	  the edge label and for a parent index in the range 0..width (width
+ * 	  itself marks 'null' nodes, see fullReset()). Every layer starts on a
+ * 	  64-bit word.
  *
- * The template argument, ReprType, is the type used to represent the nodes'
- *    information. The lower 'edgeNumBits' bits are the label, and the upper
- *    bits are the index (in range 0..width-1) of the parent. The user has to
- *    choose the right type to contain all those bits.
+ * More than 'depth' layers can be saved: layer l is kept in slot
+ *    (l % depth), replacing layer (l - depth). Paths can then only be traced
+ *    back through the newest 'depth' layers (see backtrack()).
+ *
+ * The template argument, ReprType, is the type used to pass the nodes'
+ *    information to and from the backtracker. The lower 'edgeNumBits' bits
+ *    are the label, and the upper bits are the index of the parent.
+ *
+ * FIXED_WIDTH and FIXED_EDGE_BITS, when non-zero, fix the width and the number
+ *    of edge bits at compile time, so index arithmetic becomes constant. They
+ *    must then match the values given to the constructor.
+ *
+ * Windowed traceback (see setWindow()) keeps only the newest layers. When the
+ *    window is full, the oldest layers are committed: the nodes of the newest
+ *    layer are traced back until they all share one ancestor, and the path to
+ *    that ancestor is kept as a plain sequence of edges, taking 'edgeNumBits'
+ *    bits per layer. If the nodes do not share an ancestor within the window,
+ *    the oldest half of the window is committed along the ancestors of node 0
+ *    in the newest layer (the best node, in searches that save the beam in
+ *    sorted order). Paths of nodes that did not descend from a committed
+ *    ancestor then follow the committed edges in the committed layers.
  */
-template<typename ReprType>
+template<typename ReprType,
+		 unsigned int FIXED_WIDTH = 0,
+		 unsigned int FIXED_EDGE_BITS = 0>
 class Backtracker {
 public:
 	/**
@@ -42,6 +65,15 @@ public:
 	 */
 	Backtracker(unsigned int width, unsigned int depth, unsigned int edgeBits);
 
+	/**
+	 * Sets the number of layers kept before layers are committed, and resets
+	 *     the data structure.
+	 *
+	 * @param numLayers: the number of layers to keep, at least 2. 0 keeps all
+	 *     'depth' layers, and never commits layers (the default).
+	 */
+	void setWindow(unsigned int numLayers);
+
 	/**
 	 * Resets the data structure to fresh state, where a new tree can be saved.
 	 */
@@ -73,6 +105,26 @@ public:
 	 */
 	void nextLayer();
 
+	/**
+	 * @return the number of layers that were closed with nextLayer() since
+	 *     the last reset()
+	 */
+	unsigned int numLayers();
+
+	/**
+	 * Discards all layers after the first 'numLayers' layers. Information in
+	 *     the remaining layers is kept, so the next calls to saveNode will
+	 *     relate to layer number 'numLayers'.
+	 *
+	 * With windowed traceback, committed layers are kept as committed. Nodes
+	 *     saved after rewinding into committed layers are then traced back
+	 *     along the committed edges.
+	 *
+	 * @param numLayers: the number of layers to keep. Must not be larger than
+	 *     the number of layers currently stored.
+	 */
+	void rewind(unsigned int numLayers);
+
 	/**
 	 * Performs backtracking in the tree from a specific node in the previous
 	 * layer, computing the path from the root to the node.
@@ -83,15 +135,21 @@ public:
 	 *
 	 * @param nodeIndex: the index of the node in the previous layer to find
 	 *     its path.
-	 * @param path: [out] the path from the root to the node.
+	 * @param path: [out] the path from the root to the node. If 'firstLayer'
+	 *     is non-zero, only the edges into layers firstLayer and up are
+	 *     written, with path[0] the edge into layer 'firstLayer'.
+	 * @param firstLayer: the first layer in the output path. Without windowed
+	 *     traceback, the layers from 'firstLayer' on must still be stored,
+	 *     i.e., no more than 'depth' layers were saved after it.
 	 *
-	 * @return: the parent reported by the first layer (note that this will
-	 *    always be 0 when exploring a tree, but in the general case, there
-	 *    could be several "roots")
+	 * @return: the parent reported by layer 'firstLayer' (note that this will
+	 *    always be 0 when exploring a tree from the root, but in the general
+	 *    case, there could be several "roots")
 	 */
 	template<typename EdgeType>
 	ReprType backtrack(unsigned int nodeIndex,
-	               std::vector<EdgeType>& path);
+	               std::vector<EdgeType>& path,
+	               unsigned int firstLayer = 0);
 
 	/**
 	 * Tracks a path through the backtrack structure, returning the ranks of the
@@ -102,7 +160,8 @@ public:
 	 *    find when a given path was pruned out.
 	 *
 	 * Unless all layers are always full (i.e., number of elements = width), the
-	 *    structure should be fullReset() at the beginning of the run.
+	 *    structure should be fullReset() at the beginning of the run. Committed
+	 *    layers have no rank information.
 	 *
 	 * @param path: the path to give ranks for
 	 * @return vector: ranks of the nodes along the path, as long as the path is
@@ -111,6 +170,66 @@ public:
 	std::vector<ReprType> ranks(const std::vector<ReprType>& path);
 
 private:
+	/**
+	 * @return the number of nodes in each layer
+	 */
+	unsigned int width() const
+		{ return (FIXED_WIDTH != 0) ? FIXED_WIDTH : m_width; }
+
+	/**
+	 * @return the number of bits in each edge
+	 */
+	unsigned int edgeBits() const
+		{ return (FIXED_EDGE_BITS != 0) ? FIXED_EDGE_BITS : m_edgeBits; }
+
+	/**
+	 * @return a mask to get only the edge bits from a ReprType
+	 */
+	ReprType edgeMask() const
+		{ return (FIXED_EDGE_BITS != 0) ? ReprType((1 << FIXED_EDGE_BITS) - 1) : m_edgeMask; }
+
+	/**
+	 * @return the number of bits needed to represent 'value'
+	 */
+	static unsigned int numBitsFor(unsigned int value);
+
+	/**
+	 * @return 'numBits' bits of 'words', starting at bit 'offset'
+	 */
+	static uint64_t readBits(const uint64_t* words,
+							 uint64_t offset,
+							 unsigned int numBits);
+
+	/**
+	 * Writes the lower 'numBits' bits of 'value' into 'words', starting at
+	 *     bit 'offset'
+	 */
+	static void writeBits(uint64_t* words,
+						  uint64_t offset,
+						  unsigned int numBits,
+						  uint64_t value);
+
+	/**
+	 * @return the first word of a layer's nodes
+	 */
+	uint64_t* layerWords(unsigned int layer);
+
+	/**
+	 * @return the information of a node in a stored layer
+	 */
+	ReprType node(unsigned int layer, unsigned int nodeIndex);
+
+	/**
+	 * Commits the oldest layers, when the window is full
+	 */
+	void commit();
+
+	/**
+	 * Commits all stored layers up to and including 'lastLayer', along the
+	 *     ancestors of node 'nodeIndex' in 'lastLayer'
+	 */
+	void commitPath(unsigned int lastLayer, unsigned int nodeIndex);
+
 	// The number of nodes in each layer
 	const unsigned int m_width;
 
@@ -123,131 +242,247 @@ private:
 	// A mask to get only the edge bits from a ReprType
 	const ReprType m_edgeMask;
 
-	// The structure that saves the backtracking information. The k'th node in
-	// the l'th layer is saved in m_backtracking[(l*width)+k]
-	std::vector<ReprType> m_backtracking;
+	// The number of bits each node takes
+	const unsigned int m_nodeBits;
+
+	// The number of words each layer takes
+	const unsigned int m_numLayerWords;
 
-	// The index in the array where next node should be written
-	unsigned int m_nextNodeIndex;
+	// The number of layers kept before committing, 0 if never committing
+	unsigned int m_window;
 
-	// The index in m_backtracking of the first node in the current layer
-	unsigned int m_layerFirstNodeIndex;
+	// The structure that saves the backtracking information. Layer l is saved
+	// in slot (l % number of slots), which starts at word
+	// (slot * m_numLayerWords). The k'th node in a layer starts at bit
+	// (k * m_nodeBits) of the layer.
+	std::vector<uint64_t> m_backtracking;
+
+	// The number of nodes saved in the current layer
+	unsigned int m_numLayerNodes;
+
+	// The first word of the current layer
+	uint64_t* m_layerWords;
 
 	// The current layer in the tree
 	unsigned int m_currentLayer;
+
+	// Layers before this layer are committed
+	unsigned int m_firstStoredLayer;
+
+	// The edges of committed layers, 'edgeNumBits' bits per layer
+	std::vector<uint64_t> m_committed;
+
+	// The parent reported by the first layer, once it is committed
+	ReprType m_committedRoot;
+
+	// Scratch space when looking for a common ancestor: the distinct
+	// ancestors in a layer, and markers of nodes that were already seen
+	std::vector<ReprType> m_ancestors;
+	std::vector<ReprType> m_nextAncestors;
+	std::vector<bool> m_seen;
 };
 
 // IMPLEMENTATION
 
 #include <assert.h>
 
-template<typename ReprType>
-inline Backtracker<ReprType>::Backtracker(	unsigned int width,
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::Backtracker(	unsigned int width,
 											unsigned int depth,
 											unsigned int edgeBits)
   : m_width(width),
     m_numLayers(depth),
     m_edgeBits(edgeBits),
-    m_edgeMask((1 << m_edgeBits) - 1),
-	m_backtracking(width*depth)
+    m_edgeMask((1 << edgeBits) - 1),
+    m_nodeBits(numBitsFor(width) + edgeBits),
+    m_numLayerWords(((uint64_t)width * m_nodeBits + 63) / 64),
+    m_window(0),
+    m_backtracking((uint64_t)m_numLayerWords * depth),
+    m_committedRoot(0),
+    m_seen(width, false)
 {
+	if(((FIXED_WIDTH != 0) && (width != FIXED_WIDTH))
+			|| ((FIXED_EDGE_BITS != 0) && (edgeBits != FIXED_EDGE_BITS))) {
+		throw(std::runtime_error("Backtracker dimensions do not match its fixed dimensions"));
+	}
+
+	if(m_nodeBits > 8 * sizeof(ReprType)) {
+		throw(std::runtime_error("Backtracker nodes do not fit in ReprType"));
+	}
+
 	reset();
 }
 
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline void Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::setWindow(unsigned int numLayers) {
+	if((numLayers == 0) || (numLayers >= m_numLayers)) {
+		// All layers fit, no need to commit
+		m_window = 0;
+		m_backtracking.resize((uint64_t)m_numLayerWords * m_numLayers);
+		m_committed.clear();
+	} else {
+		if(numLayers < 2) {
+			throw(std::runtime_error("Backtracker window must hold at least 2 layers"));
+		}
 
+		m_window = numLayers;
+		m_backtracking.resize((uint64_t)m_numLayerWords * m_window);
+		m_committed.resize(((uint64_t)m_numLayers * edgeBits() + 63) / 64);
+		m_ancestors.reserve(width());
+		m_nextAncestors.reserve(width());
+	}
+
+	reset();
+}
 
-template<typename ReprType>
-inline void Backtracker<ReprType>::reset() {
-	m_layerFirstNodeIndex = 0;
-	m_nextNodeIndex = 0;
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline void Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::reset() {
+	m_numLayerNodes = 0;
 	m_currentLayer = 0;
+	m_firstStoredLayer = 0;
+	m_layerWords = layerWords(0);
 }
 
-template<typename ReprType>
-inline void Backtracker<ReprType>::fullReset() {
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline void Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::fullReset() {
 	// Perform a regular reset
 	reset();
 
 	// Fill m_backtracking with 'null' value
-	std::fill(m_backtracking.begin(), m_backtracking.end(), m_width << m_edgeBits);
+	unsigned int numSlots = m_backtracking.size() / m_numLayerWords;
+	for(unsigned int slot = 0; slot < numSlots; slot++) {
+		uint64_t* words = &m_backtracking[(uint64_t)slot * m_numLayerWords];
+		for(unsigned int i = 0; i < width(); i++) {
+			writeBits(words,
+					  (uint64_t)i * m_nodeBits,
+					  m_nodeBits,
+					  width() << edgeBits());
+		}
+	}
 }
 
 
-template<typename ReprType>
-inline void Backtracker<ReprType>::saveNode(ReprType parent,
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline void Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::saveNode(ReprType parent,
 											ReprType edgeLabel) {
 	// Make sure we did not advance layers without calling nextLayer()
-	assert(m_nextNodeIndex < m_layerFirstNodeIndex + m_width);
+	assert(m_numLayerNodes < width());
 	// Make sure user did not call saveNode after calling nextLayer on the last
-	// layer
-	assert(m_nextNodeIndex < m_backtracking.size());
+	// layer. Only windowed traceback is limited, by the committed edges.
+	assert((m_window == 0) || (m_currentLayer < m_numLayers));
 
 	// Make sure edgeLabel has right number of bits
-	assert((edgeLabel & (~((1 << m_edgeBits) - 1))) == 0);
+	assert((edgeLabel & (~((1 << edgeBits()) - 1))) == 0);
 
 	// Update backtracking structure
-	m_backtracking[m_nextNodeIndex] = ((parent << m_edgeBits) | edgeLabel);
+	writeBits(m_layerWords,
+			  (uint64_t)m_numLayerNodes * m_nodeBits,
+			  m_nodeBits,
+			  (parent << edgeBits()) | edgeLabel);
 
 	// Advance index of next node
-	m_nextNodeIndex++;
+	m_numLayerNodes++;
 }
 
-template<typename ReprType>
-inline void Backtracker<ReprType>::nextLayer() {
-	// Advance the layer index
-	m_layerFirstNodeIndex += m_width;
-
-	// Set the next node to be the new layer's first node
-	m_nextNodeIndex = m_layerFirstNodeIndex;
-
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline void Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::nextLayer() {
 	// Update the current depth
 	m_currentLayer++;
 
-	// Make sure we haven't gone too deep in layers
-	assert(m_currentLayer <= m_numLayers);
+	if(m_window != 0) {
+		// Make sure we haven't gone too deep in layers
+		assert(m_currentLayer <= m_numLayers);
+
+		if(m_currentLayer - m_firstStoredLayer == m_window) {
+			// Make room for the next layer
+			commit();
+		}
+	}
+
+	// The next node is the new layer's first node
+	m_numLayerNodes = 0;
+	if((m_window == 0) || (m_currentLayer < m_numLayers)) {
+		m_layerWords = layerWords(m_currentLayer);
+	}
+}
+
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline unsigned int Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::numLayers() {
+	return m_currentLayer;
+}
+
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline void Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::rewind(unsigned int numLayers) {
+	// Can only discard layers, not add them
+	assert(numLayers <= m_currentLayer);
+
+	m_currentLayer = numLayers;
+	m_firstStoredLayer = std::min(m_firstStoredLayer, numLayers);
+	m_numLayerNodes = 0;
+	if((m_window == 0) || (m_currentLayer < m_numLayers)) {
+		m_layerWords = layerWords(m_currentLayer);
+	}
 }
 
-template<typename ReprType>
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
 template<typename EdgeType>
-inline ReprType Backtracker<ReprType>::backtrack(
+inline ReprType Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::backtrack(
 										unsigned int nodeIndex,
-										std::vector<EdgeType> & path)
+										std::vector<EdgeType> & path,
+										unsigned int firstLayer)
 {
 	// Sanity check: there hasn't been any saveNode()s since last nextLayer
-	assert(m_nextNodeIndex == m_layerFirstNodeIndex);
+	assert(m_numLayerNodes == 0);
 
 	// Sanity check: there has been at least one layer that has been input
-	assert(m_layerFirstNodeIndex > 0);
+	assert(m_currentLayer > 0);
+	assert(firstLayer < m_currentLayer);
+
+	// Without a window, older layers were overwritten by newer ones
+	assert((m_window != 0) || (m_currentLayer - firstLayer <= m_numLayers));
 
 	// Resize the output vector to contain enough layers to backtrack
-	path.resize(m_currentLayer);
+	path.resize(m_currentLayer - firstLayer);
 
 	// extract the bits from the edge structure into a vector of ints (by time)
-	unsigned int layerFirstNode = m_layerFirstNodeIndex - m_width;
-
-	for (int layer = (int)m_currentLayer - 1; layer >= 0; layer--) {
+	int lastStoredLayer = (int)std::max(m_firstStoredLayer, firstLayer);
+	for (int layer = (int)m_currentLayer - 1; layer >= lastStoredLayer; layer--) {
 		// Get the information from the saved node
-		ReprType edgeInfo = m_backtracking[layerFirstNode + nodeIndex];
+		ReprType edgeInfo = node(layer, nodeIndex);
 
 		// Extract the edge bits, and save into output vector
-		path[layer] = (edgeInfo & m_edgeMask);
+		path[layer - firstLayer] = (edgeInfo & edgeMask());
 
 		// Get the bits that represent the parent
-		nodeIndex = edgeInfo >> m_edgeBits;
-		// Move to the parents' layer
-		layerFirstNode -= m_width;
+		nodeIndex = edgeInfo >> edgeBits();
+	}
+
+	if(m_firstStoredLayer <= firstLayer) {
+		return nodeIndex;
+	}
+
+	// Committed layers
+	for(unsigned int layer = firstLayer; layer < m_firstStoredLayer; layer++) {
+		path[layer - firstLayer] = readBits(&m_committed[0],
+											(uint64_t)layer * edgeBits(),
+											edgeBits());
 	}
 
-	return nodeIndex;
+	if(firstLayer > 0) {
+		// The committed path's node in 'firstLayer' is not known
+		return 0;
+	}
+
+	return m_committedRoot;
 }
 
 
-template<typename ReprType>
-inline std::vector<ReprType> Backtracker<ReprType>::ranks(
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline std::vector<ReprType> Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::ranks(
 		const std::vector<ReprType>& path)
 {
 	// Sanity check: there hasn't been any saveNode()s since last nextLayer
-	assert(m_nextNodeIndex == m_layerFirstNodeIndex);
+	assert(m_numLayerNodes == 0);
 
 	// Sanity check: there has been at least one layer that has been input
 	assert(m_currentLayer > 0);
@@ -264,11 +499,11 @@ inline std::vector<ReprType> Backtracker<ReprType>::ranks(
 	ReprType parent = 0;
 
 	// Go through each layer
-	for(uint32_t layerInd = 0; layerInd < m_currentLayer; layerInd++) {
+	for(uint32_t layerInd = m_firstStoredLayer; layerInd < m_currentLayer; layerInd++) {
 		// Search for a mention of the edge from the parent in the current layer
-		ReprType wantedNode = (parent << m_edgeBits) | path[layerInd];
-		for(uint32_t nodeInd = 0; nodeInd < m_width; nodeInd++) {
-			if(m_backtracking[(layerInd * m_width) + nodeInd] == wantedNode) {
+		ReprType wantedNode = (parent << edgeBits()) | path[layerInd];
+		for(uint32_t nodeInd = 0; nodeInd < width(); nodeInd++) {
+			if(node(layerInd, nodeInd) == wantedNode) {
 				result.push_back(nodeInd);
 				parent = nodeInd;
 				break; // break inner loop - go to next layer
@@ -282,3 +517,129 @@ inline std::vector<ReprType> Backtracker<ReprType>::ranks(
 	// Found the full path - return all ranks
 	return result;
 }
+
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline unsigned int Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::numBitsFor(unsigned int value) {
+	unsigned int numBits = 0;
+	while(value > 0) {
+		numBits++;
+		value >>= 1;
+	}
+	return numBits;
+}
+
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline uint64_t Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::readBits(
+		const uint64_t* words,
+		uint64_t offset,
+		unsigned int numBits)
+{
+	const uint64_t* word = words + (offset >> 6);
+	unsigned int shift = offset & 63;
+
+	uint64_t value = word[0] >> shift;
+	if(shift + numBits > 64) {
+		// The value continues in the next word
+		value |= word[1] << (64 - shift);
+	}
+	return value & ((uint64_t(1) << numBits) - 1);
+}
+
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline void Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::writeBits(
+		uint64_t* words,
+		uint64_t offset,
+		unsigned int numBits,
+		uint64_t value)
+{
+	uint64_t* word = words + (offset >> 6);
+	unsigned int shift = offset & 63;
+	const uint64_t mask = (uint64_t(1) << numBits) - 1;
+
+	word[0] = (word[0] & ~(mask << shift)) | ((value & mask) << shift);
+	if(shift + numBits > 64) {
+		// The value continues in the next word
+		word[1] = (word[1] & ~(mask >> (64 - shift)))
+				| ((value & mask) >> (64 - shift));
+	}
+}
+
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline uint64_t* Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::layerWords(unsigned int layer) {
+	unsigned int slot = layer % ((m_window != 0) ? m_window : m_numLayers);
+	return &m_backtracking[(uint64_t)slot * m_numLayerWords];
+}
+
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline ReprType Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::node(
+		unsigned int layer,
+		unsigned int nodeIndex)
+{
+	return ReprType(readBits(layerWords(layer),
+							 (uint64_t)nodeIndex * m_nodeBits,
+							 m_nodeBits));
+}
+
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline void Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::commit() {
+	// Start from the parents of all nodes in the newest layer, so the newest
+	// layer always stays stored
+	unsigned int layer = m_currentLayer - 1;
+	m_ancestors.clear();
+	for(unsigned int i = 0; i < m_numLayerNodes; i++) {
+		m_ancestors.push_back(i);
+	}
+
+	// Trace back while the nodes have several ancestors
+	do {
+		m_nextAncestors.clear();
+		for(unsigned int i = 0; i < m_ancestors.size(); i++) {
+			ReprType parent = node(layer, m_ancestors[i]) >> edgeBits();
+			if(!m_seen[parent]) {
+				m_seen[parent] = true;
+				m_nextAncestors.push_back(parent);
+			}
+		}
+		for(unsigned int i = 0; i < m_nextAncestors.size(); i++) {
+			m_seen[m_nextAncestors[i]] = false;
+		}
+
+		m_ancestors.swap(m_nextAncestors);
+		layer--;
+	} while((m_ancestors.size() > 1) && (layer > m_firstStoredLayer));
+
+	if((m_ancestors.size() == 1) && (layer >= m_firstStoredLayer)) {
+		// All nodes descend from the same node in 'layer'
+		commitPath(layer, m_ancestors[0]);
+		return;
+	}
+
+	// No common ancestor in the window: follow the ancestors of the best node
+	unsigned int lastLayer = m_firstStoredLayer + (m_window / 2) - 1;
+	unsigned int nodeIndex = 0;
+	for(unsigned int l = m_currentLayer - 1; l > lastLayer; l--) {
+		nodeIndex = node(l, nodeIndex) >> edgeBits();
+	}
+	commitPath(lastLayer, nodeIndex);
+}
+
+template<typename ReprType, unsigned int FIXED_WIDTH, unsigned int FIXED_EDGE_BITS>
+inline void Backtracker<ReprType, FIXED_WIDTH, FIXED_EDGE_BITS>::commitPath(
+		unsigned int lastLayer,
+		unsigned int nodeIndex)
+{
+	for(int layer = (int)lastLayer; layer >= (int)m_firstStoredLayer; layer--) {
+		ReprType edgeInfo = node(layer, nodeIndex);
+		writeBits(&m_committed[0],
+				  (uint64_t)layer * edgeBits(),
+				  edgeBits(),
+				  edgeInfo & edgeMask());
+		nodeIndex = edgeInfo >> edgeBits();
+	}
+
+	if(m_firstStoredLayer == 0) {
+		m_committedRoot = nodeIndex;
+	}
+
+	m_firstStoredLayer = lastLayer + 1;
+}
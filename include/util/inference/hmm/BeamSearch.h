@@ -9,6 +9,8 @@
 #include "Backtracker.h"
 #include "BestK.h"
 #include "DualPool.h"
+#include "SoADualPool.h"
+#include "WeightTraits.h"
 
 /**
  * \ingroup hmm
@@ -23,6 +25,34 @@ struct SearchIntermediateResult {
 	Node node;
 };
 
+/**
+ * \ingroup hmm
+ * \brief Detects whether a branch evaluator can evaluate all children of a
+ *     node in one call, with a method
+ *     void branchAll(Node& parent, BranchData& data, Node* children)
+ */
+template<typename BranchEvaluator>
+class HasBranchAll {
+private:
+	typedef typename BranchEvaluator::Node Node;
+	typedef typename BranchEvaluator::BranchData BranchData;
+
+	typedef char Yes;
+	typedef struct { char dummy[2]; } No;
+
+	template<typename T, void (T::*)(Node&, BranchData&, Node*)>
+	struct Signature {};
+
+	template<typename T>
+	static Yes test(Signature<T, &T::branchAll>*);
+
+	template<typename T>
+	static No test(...);
+
+public:
+	enum { value = (sizeof(test<BranchEvaluator>(0)) == sizeof(Yes)) };
+};
+
 
 /**
  * \ingroup hmm
@@ -60,8 +90,23 @@ struct SearchIntermediateResult {
  *     half that contained the children, now contains the beam, and the other
  *     half can be used for the children in the next advance() call. (ie the
  *     two pointers are swapped)
+ *
+ * FIXED_LOG_BRANCH_FACTOR and FIXED_BEAM_WIDTH, when non-zero, fix the
+ *    branch factor and beam width at compile time. The loops over children
+ *    then have constant trip counts, and the node pool has a constant size. The
+ *    logBranchFactor and pruner size given at construction must match them.
+ *
+ * NodePool is the node pool's layout: DualPool keeps whole nodes, and
+ *    SoADualPool keeps each field of the nodes in its own array.
+ *
+ * If the branch evaluator asks for renormalization (see RenormalizesWeights),
+ *    the best weight in the beam is subtracted from all beam nodes after every
+ *    step. Weights are then relative to the best path, rather than absolute.
  */
-template<typename BranchEvaluator, template<class> class Pruner>
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR = 0,
+		 unsigned int FIXED_BEAM_WIDTH = 0,
+		 template<class, unsigned int> class NodePool = DualPool>
 class BeamSearch {
 private:
 	// forward declaration
@@ -138,10 +183,16 @@ public:
 	 * 	@param bestPath: [out] will contain the index of the branch taken, in
 	 * 		a path from the root to the best leaf. bestPath[0] is the edge out
 	 * 		of the root, bestPath[1] the edge from depth 1 to depth 2, etc.
+	 * 	@param firstLayer: when non-zero, only the edges from depth
+	 * 		'firstLayer' on are written, bestPath[0] being the edge from depth
+	 * 		firstLayer to depth firstLayer + 1. The search can then advance
+	 * 		beyond maxSearchDepth, as long as the path covers no more than
+	 * 		maxSearchDepth steps.
 	 * 	@return: reference to the best leaf. This allows the caller to extract
 	 * 		more information out of the leaf, if the caller requires.
 	 */
-	Node& getBestPath(std::vector<unsigned short>& bestPath);
+	Node& getBestPath(std::vector<unsigned short>& bestPath,
+					  unsigned int firstLayer = 0);
 
 
 	/**
@@ -156,7 +207,92 @@ public:
 	void getIntermediate(
 			std::vector<SearchIntermediateResult<Node> >& interm);
 
+	/**
+	 * Enables or disables saving a copy of the beam after every advance(), so
+	 *     the search can later be rewound to an earlier depth with rewind().
+	 *
+	 * Checkpoints take memory for maxSearchDepth full beams, so they are
+	 *     disabled by default.
+	 */
+	void setCheckpointing(bool enable);
+
+	/**
+	 * Returns the search to the state it had after the first 'depth' calls to
+	 *     advance() since initialize(). Calls to advance() after rewind()
+	 *     continue the search from that depth.
+	 *
+	 * @param depth: the wanted depth
+	 * @return the depth the search was actually rewound to. This is never more
+	 *     than 'depth', and is the current depth if 'depth' is larger than it.
+	 *     A return value of 0 means the search could not be rewound, and the
+	 *     caller should initialize() the search again.
+	 */
+	unsigned int rewind(unsigned int depth);
+
+	/**
+	 * Limits the backtracking information to the newest 'numLayers' layers,
+	 *     so its memory does not grow with the search depth. Older layers are
+	 *     committed to a single path (see Backtracker::setWindow). 0 keeps
+	 *     all layers (the default).
+	 *
+	 * @note must be called before initialize()
+	 */
+	void setTracebackWindow(unsigned int numLayers);
+
 private:
+	// Selects a branching strategy at compile time
+	template<bool value> struct BoolTag {};
+
+	/**
+	 * Evaluates all children of 'parent' into 'children'. Uses the
+	 *     evaluator's branchAll() if it has one, and branch() for every child
+	 *     otherwise.
+	 */
+	void branchChildren(Node& parent,
+						BranchData& branchData,
+						Node* children,
+						BoolTag<true>);
+	void branchChildren(Node& parent,
+						BranchData& branchData,
+						Node* children,
+						BoolTag<false>);
+
+	/**
+	 * Subtracts the weight of the best node in the beam from the weights of
+	 *     all beam nodes, if the evaluator renormalizes weights
+	 */
+	void renormalize(BoolTag<true>);
+	void renormalize(BoolTag<false>) {}
+
+	/**
+	 * Saves the current beam as the checkpoint for the current depth
+	 */
+	void saveCheckpoint();
+
+	/**
+	 * @return the number of bits in branchFactor
+	 */
+	unsigned int logBranchFactor() const {
+		return (FIXED_LOG_BRANCH_FACTOR != 0) ? FIXED_LOG_BRANCH_FACTOR
+											  : m_logBranchFactor;
+	}
+
+	/**
+	 * @return the number of children of each node
+	 */
+	unsigned int branchFactor() const {
+		return (FIXED_LOG_BRANCH_FACTOR != 0) ? (1u << FIXED_LOG_BRANCH_FACTOR)
+											  : m_branchFactor;
+	}
+
+	/**
+	 * @return the maximum number of nodes in the beam
+	 */
+	unsigned int beamWidth() {
+		return (FIXED_BEAM_WIDTH != 0) ? FIXED_BEAM_WIDTH
+									   : m_nextBeam.maxSize();
+	}
+
 	/**
 	 * A structure that holds information about a node in the search.
 	 */
@@ -166,7 +302,7 @@ private:
 		Suggestion(Weight _weight, unsigned int _poolIndex)
 			: weight(_weight), poolIndex(_poolIndex) {}
 
-		// Compares two suggestions based on weight
+		// Compares two suggestions based on weight, then pool index
 		bool operator< (const Suggestion& other) const;
 
 		// The weight of the node
@@ -195,13 +331,34 @@ private:
 	const unsigned int m_branchFactor;
 
 	// Backtracker
-	Backtracker<unsigned int> m_backtracker;
+	Backtracker<unsigned int,
+				FIXED_BEAM_WIDTH,
+				FIXED_LOG_BRANCH_FACTOR> m_backtracker;
 
 	// All nodes used in the search, including the beam, and the children.
-	DualPool<Node> m_nodePool;
+	NodePool<Node,
+			 FIXED_BEAM_WIDTH << FIXED_LOG_BRANCH_FACTOR> m_nodePool;
+
+	// The root, as set by the caller. It is moved into the node pool on the
+	// first advance() after initialize()
+	Node m_root;
+	bool m_rootPending;
 
 	// The indices of elements in the beam
 	std::vector<Suggestion> m_beam;
+
+	// True if the beam should be saved after every advance()
+	bool m_checkpointing;
+
+	// The number of layers the backtracker keeps, 0 for all
+	unsigned int m_tracebackWindow;
+
+	// Saved beams. The beam after the d'th advance() is saved in entries
+	// [(d-1) * maxSize, (d-1) * maxSize + m_checkpointSizes[d-1]) of
+	// m_checkpointBeams. The matching nodes are saved in m_checkpointNodes.
+	std::vector<Suggestion> m_checkpointBeams;
+	std::vector<Node> m_checkpointNodes;
+	std::vector<unsigned int> m_checkpointSizes;
 };
 
 
@@ -209,8 +366,10 @@ private:
 
 #include <stdexcept>
 
-template<typename BranchEvaluator, template<class> class Pruner>
-inline BeamSearch<BranchEvaluator,Pruner>::BeamSearch(
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::BeamSearch(
 		PrunerParams& prunerParams,
 		unsigned int maxSearchDepth,
 		const BranchEvaluator & branchEvaluator,
@@ -223,20 +382,28 @@ inline BeamSearch<BranchEvaluator,Pruner>::BeamSearch(
     m_branchFactor(1 << m_logBranchFactor),
     m_backtracker(m_nextBeam.maxSize(), m_maxSearchDepth, m_logBranchFactor),
     m_nodePool(m_nextBeam.maxSize() * m_branchFactor),
-    m_beam()
+    m_beam(),
+    m_rootPending(false),
+    m_checkpointing(false),
+    m_tracebackWindow(0)
 {
-	m_beam.reserve(m_nextBeam.maxSize());
+	if(((FIXED_LOG_BRANCH_FACTOR != 0) && (m_logBranchFactor != FIXED_LOG_BRANCH_FACTOR))
+			|| ((FIXED_BEAM_WIDTH != 0) && (m_nextBeam.maxSize() != FIXED_BEAM_WIDTH))) {
+		throw(std::runtime_error("BeamSearch parameters do not match its fixed parameters"));
+	}
+
+	m_beam.reserve(beamWidth());
 
 	// Initialize the node pool
-	for(unsigned int i = 0; i < m_nodePool.size(); i++) {
-		m_branchEvaluator.initNode(m_nodePool.primary(i));
-		m_branchEvaluator.initNode(m_nodePool.secondary(i));
-	}
+	m_nodePool.initNodes(m_branchEvaluator);
+	m_branchEvaluator.initNode(m_root);
 }
 
 
-template<typename BranchEvaluator, template<class> class Pruner>
-inline BeamSearch<BranchEvaluator,Pruner>::BeamSearch(const BeamSearch& other)
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::BeamSearch(const BeamSearch& other)
   : m_prunerParams(other.m_prunerParams),
     m_nextBeam(m_prunerParams),
 	m_maxSearchDepth(other.m_maxSearchDepth),
@@ -245,48 +412,67 @@ inline BeamSearch<BranchEvaluator,Pruner>::BeamSearch(const BeamSearch& other)
 	m_branchFactor(1 << m_logBranchFactor),
     m_backtracker(m_nextBeam.maxSize(), m_maxSearchDepth, m_logBranchFactor),
     m_nodePool(m_nextBeam.maxSize() * m_branchFactor),
-    m_beam()
+    m_beam(),
+    m_rootPending(false),
+    m_checkpointing(false),
+    m_tracebackWindow(0)
 {
-	m_beam.reserve(m_nextBeam.maxSize());
+	m_beam.reserve(beamWidth());
 
 	// Initialize the node pool
-	for(unsigned int i = 0; i < m_nodePool.size(); i++) {
-		m_branchEvaluator.initNode(m_nodePool.primary(i));
-		m_branchEvaluator.initNode(m_nodePool.secondary(i));
-	}
+	m_nodePool.initNodes(m_branchEvaluator);
+	m_branchEvaluator.initNode(m_root);
+
+	setCheckpointing(other.m_checkpointing);
+	setTracebackWindow(other.m_tracebackWindow);
 }
 
-template<typename BranchEvaluator, template<class> class Pruner>
-inline BranchEvaluator & BeamSearch<BranchEvaluator,Pruner>::branchEvaluator() {
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline BranchEvaluator & BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::branchEvaluator() {
 	return m_branchEvaluator;
 }
 
-template<typename BranchEvaluator, template<class> class Pruner>
-inline void	BeamSearch<BranchEvaluator,Pruner>::initialize()
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline void	BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::initialize()
 {
 	// Reset backtracking
 	m_backtracker.reset();
 
 	m_beam.clear();
 	m_beam.push_back(Suggestion(0,0));
+	m_rootPending = true;
 
 	m_backtracker.reset();
 }
 
-template<typename BranchEvaluator, template<class> class Pruner>
-inline typename BeamSearch<BranchEvaluator,Pruner>::Node &
-BeamSearch<BranchEvaluator,Pruner>::getRoot()
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline typename BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::Node &
+BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::getRoot()
 {
-	return m_nodePool.primary(0);
+	return m_root;
 }
 
 
-template<typename BranchEvaluator, template<class> class Pruner>
-inline void BeamSearch<BranchEvaluator,Pruner>::advance(BranchData& branchData)
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline void BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::advance(BranchData& branchData)
 {
 	// Sanity check: m_nextBeam is always empty before and after advance()
 	assert(m_nextBeam.size() == 0);
 
+	if(m_rootPending) {
+		// The beam holds only the root, at pool index 0
+		m_nodePool.setPrimary(0, m_root);
+		m_rootPending = false;
+	}
+
 	// The index into m_childPool of the suggestion being computed
 	unsigned int poolIndex = 0;
 
@@ -299,27 +485,24 @@ inline void BeamSearch<BranchEvaluator,Pruner>::advance(BranchData& branchData)
 
 			Node& beamNode(m_nodePool.primary(beamIter->poolIndex));
 
-			// enumerate over all possible bit combinations
-			for (unsigned int msgBits = 0; msgBits < m_branchFactor; msgBits++) {
-
-				Node& childNode(m_nodePool.secondary(poolIndex));
+			// Evaluate all possible bit combinations
+			Node* children = m_nodePool.childSlots(poolIndex, branchFactor());
+			branchChildren(beamNode,
+						   branchData,
+						   children,
+						   BoolTag<HasBranchAll<BranchEvaluator>::value>());
+			m_nodePool.commitChildren(poolIndex, branchFactor());
 
-				// Evaluate the branch
-				m_branchEvaluator.branch(beamNode,
-										 msgBits,
-										 branchData,
-										 childNode);
-
-				// update m_nextBeam with the new value.
-				m_nextBeam.push(Suggestion(
-									childNode.getWeight(),
-									poolIndex));
+			// update m_nextBeam with the new values.
+			for (unsigned int msgBits = 0; msgBits < branchFactor(); msgBits++) {
+				m_nextBeam.push(Suggestion(children[msgBits].getWeight(),
+										   poolIndex));
 
 				poolIndex++;
 			}
 		} else {
 			// We will not branch these nodes, advance poolIndex accordingly
-			poolIndex += m_branchFactor;
+			poolIndex += branchFactor();
 		}
 	}
 
@@ -331,32 +514,74 @@ inline void BeamSearch<BranchEvaluator,Pruner>::advance(BranchData& branchData)
 	m_nodePool.flip();
 
 	// Sanity check: there should be at most m_beamWidth elements in beam.
-	assert(m_beam.size() <= m_nextBeam.maxSize());
+	assert(m_beam.size() <= beamWidth());
+
+	// Keep weights relative to the best node, if the evaluator needs it
+	renormalize(BoolTag<RenormalizesWeights<BranchEvaluator>::value>());
 
 	// save backtracking information
 	typename std::vector<Suggestion>::iterator beamNode;
 	for(beamNode = m_beam.begin(); beamNode != m_beam.end(); beamNode++) {
 		unsigned int poolIndex = beamNode->poolIndex;
-		m_backtracker.saveNode(poolIndex >> m_logBranchFactor,
-							   poolIndex & (m_branchFactor - 1));
+		m_backtracker.saveNode(poolIndex >> logBranchFactor(),
+							   poolIndex & (branchFactor() - 1));
 	}
 
 	// Close this layer in the backtracker
 	m_backtracker.nextLayer();
+
+	if(m_checkpointing) {
+		saveCheckpoint();
+	}
+}
+
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline void BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::branchChildren(
+		Node& parent,
+		BranchData& branchData,
+		Node* children,
+		BoolTag<true>)
+{
+	m_branchEvaluator.branchAll(parent, branchData, children);
 }
 
-template<typename BranchEvaluator, template<class> class Pruner>
-inline typename BeamSearch<BranchEvaluator,Pruner>::Node &
-	BeamSearch<BranchEvaluator,Pruner>::getBestPath(
-									std::vector<unsigned short> & bestPath)
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline void BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::branchChildren(
+		Node& parent,
+		BranchData& branchData,
+		Node* children,
+		BoolTag<false>)
 {
-	m_backtracker.backtrack<unsigned short>(0, bestPath);
+	// enumerate over all possible bit combinations
+	for (unsigned int msgBits = 0; msgBits < branchFactor(); msgBits++) {
+		m_branchEvaluator.branch(parent,
+								 msgBits,
+								 branchData,
+								 children[msgBits]);
+	}
+}
+
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline typename BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::Node &
+	BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::getBestPath(
+									std::vector<unsigned short> & bestPath,
+									unsigned int firstLayer)
+{
+	m_backtracker.template backtrack<unsigned short>(0, bestPath, firstLayer);
 	return m_nodePool.primary(m_beam[0].poolIndex);
 }
 
 
-template<typename BranchEvaluator, template<class> class Pruner>
-inline void BeamSearch<BranchEvaluator,Pruner>::getIntermediate(
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline void BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::getIntermediate(
 		std::vector<SearchIntermediateResult<Node> > & interm)
 {
 	interm.clear();
@@ -368,10 +593,118 @@ inline void BeamSearch<BranchEvaluator,Pruner>::getIntermediate(
 	}
 }
 
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline void BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::setCheckpointing(bool enable)
+{
+	m_checkpointing = enable;
+
+	if(m_checkpointing && m_checkpointSizes.empty()) {
+		// Allocate storage for a full beam in every depth
+		unsigned int numSaved = m_maxSearchDepth * beamWidth();
+		m_checkpointBeams.resize(numSaved, Suggestion(0,0));
+		m_checkpointNodes.resize(numSaved);
+		m_checkpointSizes.resize(m_maxSearchDepth, 0);
+
+		for(unsigned int i = 0; i < numSaved; i++) {
+			m_branchEvaluator.initNode(m_checkpointNodes[i]);
+		}
+	}
+}
+
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline void BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::renormalize(BoolTag<true>)
+{
+	if(m_beam.empty()) {
+		return;
+	}
+
+	// The pruner places the best node first
+	const Weight offset = m_beam[0].weight;
+
+	typename std::vector<Suggestion>::iterator beamIter;
+	for(beamIter = m_beam.begin(); beamIter != m_beam.end(); beamIter++) {
+		beamIter->weight -= offset;
+
+		// primary() of some pools is a copy, so the node is written back
+		Node& node = m_nodePool.primary(beamIter->poolIndex);
+		m_branchEvaluator.renormalize(node, offset);
+		m_nodePool.setPrimary(beamIter->poolIndex, node);
+	}
+}
+
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline void BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::saveCheckpoint()
+{
+	// Checkpoint of depth d is saved in slot d-1
+	unsigned int slot = m_backtracker.numLayers() - 1;
+	unsigned int offset = slot * beamWidth();
+
+	for(unsigned int i = 0; i < m_beam.size(); i++) {
+		m_checkpointBeams[offset + i] = m_beam[i];
+		m_checkpointNodes[offset + i] = m_nodePool.primary(m_beam[i].poolIndex);
+	}
+	m_checkpointSizes[slot] = m_beam.size();
+}
+
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline unsigned int BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::rewind(unsigned int depth)
+{
+	unsigned int currentDepth = m_backtracker.numLayers();
+
+	if(depth >= currentDepth) {
+		// Already there, nothing to restore
+		return currentDepth;
+	}
+
+	if((!m_checkpointing) || (depth == 0)) {
+		// The root is initialized by the caller, so it is not checkpointed
+		return 0;
+	}
+
+	unsigned int slot = depth - 1;
+	unsigned int offset = slot * beamWidth();
+	unsigned int beamSize = m_checkpointSizes[slot];
+
+	// Restore the beam and its nodes. The saved pool indices refer to the
+	// primary pool, which holds the beam between calls to advance()
+	m_beam.assign(m_checkpointBeams.begin() + offset,
+				  m_checkpointBeams.begin() + offset + beamSize);
+	for(unsigned int i = 0; i < beamSize; i++) {
+		m_nodePool.setPrimary(m_beam[i].poolIndex, m_checkpointNodes[offset + i]);
+	}
+
+	// Forget backtracking information of the discarded layers
+	m_backtracker.rewind(depth);
+
+	return depth;
+}
+
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline void BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::setTracebackWindow(unsigned int numLayers)
+{
+	m_tracebackWindow = numLayers;
+	m_backtracker.setWindow(numLayers);
+}
+
 // BEAMSEARCH::SUGGESTION
-template<typename BranchEvaluator, template<class> class Pruner>
-inline bool BeamSearch<BranchEvaluator,Pruner>::Suggestion::operator <(
+template<typename BranchEvaluator, template<class> class Pruner,
+		 unsigned int FIXED_LOG_BRANCH_FACTOR, unsigned int FIXED_BEAM_WIDTH,
+		 template<class, unsigned int> class NodePool>
+inline bool BeamSearch<BranchEvaluator,Pruner,FIXED_LOG_BRANCH_FACTOR,FIXED_BEAM_WIDTH,NodePool>::Suggestion::operator <(
 		const Suggestion & other) const
 {
-	return weight < other.weight;
+	// Breaking ties by pool index makes the beam independent of the pruner's
+	// internal order, so equivalent searches give identical results
+	return (weight < other.weight) ||
+		   ((weight == other.weight) && (poolIndex < other.poolIndex));
 }
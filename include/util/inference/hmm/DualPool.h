@@ -12,8 +12,11 @@
  *     two pools, 'primary' and 'secondary' by index, and a special operation
  *     'flip', causes the access to switch: primary becomes secondary and vice
  *     versa.
+ *
+ * When FIXED_SIZE is non-zero, the pool size is a compile-time constant, and
+ *     'poolSize' given to the constructor must equal it.
  */
-template<typename Element>
+template<typename Element, unsigned int FIXED_SIZE = 0>
 class DualPool {
 public:
 	/**
@@ -58,6 +61,29 @@ public:
 	Element* primaryPtr(unsigned int i);
 	Element* secondaryPtr(unsigned int i);
 
+	/**
+	 * Calls evaluator.initNode() on every element of both pools
+	 */
+	template<typename Evaluator>
+	void initNodes(Evaluator& evaluator);
+
+	/**
+	 * Sets element i of the primary pool
+	 */
+	void setPrimary(unsigned int i, const Element& element);
+
+	/**
+	 * Returns where 'n' elements, to become secondary(first)..
+	 *     secondary(first+n-1), should be written. After they are written,
+	 *     commitChildren() must be called with the same arguments.
+	 */
+	Element* childSlots(unsigned int first, unsigned int n);
+
+	/**
+	 * Stores the elements written to childSlots(first, n)
+	 */
+	void commitChildren(unsigned int first, unsigned int n);
+
 private:
 	unsigned int m_size;
 
@@ -76,8 +102,8 @@ private:
 #include <algorithm>
 #include <stdexcept>
 
-template<typename Element>
-inline DualPool<Element>::DualPool(unsigned int poolSize)
+template<typename Element, unsigned int FIXED_SIZE>
+inline DualPool<Element, FIXED_SIZE>::DualPool(unsigned int poolSize)
 	:m_size(poolSize),
 	 m_pool(new Element[2 * m_size]),
 	 m_primary(m_pool),
@@ -86,10 +112,14 @@ inline DualPool<Element>::DualPool(unsigned int poolSize)
 	if(m_pool == NULL) {
 		throw(std::runtime_error("Unable to allocate pool"));
 	}
+	if((FIXED_SIZE != 0) && (m_size != FIXED_SIZE)) {
+		delete [] m_pool;
+		throw(std::runtime_error("Pool size does not match its fixed size"));
+	}
 }
 
-template<typename Element>
-inline DualPool<Element>::DualPool(const DualPool & other)
+template<typename Element, unsigned int FIXED_SIZE>
+inline DualPool<Element, FIXED_SIZE>::DualPool(const DualPool & other)
 :m_size(other.m_size),
  m_pool(new Element[2 * m_size]),
  m_primary(m_pool),
@@ -100,38 +130,63 @@ inline DualPool<Element>::DualPool(const DualPool & other)
 	}
 }
 
-template<typename Element>
-inline DualPool<Element>::~DualPool() {
+template<typename Element, unsigned int FIXED_SIZE>
+inline DualPool<Element, FIXED_SIZE>::~DualPool() {
 	delete [] m_pool;
 }
 
-template<typename Element>
-inline unsigned int DualPool<Element>::size() {
-	return m_size;
+template<typename Element, unsigned int FIXED_SIZE>
+inline unsigned int DualPool<Element, FIXED_SIZE>::size() {
+	return (FIXED_SIZE != 0) ? FIXED_SIZE : m_size;
 }
 
-template<typename Element>
-inline void DualPool<Element>::flip() {
+template<typename Element, unsigned int FIXED_SIZE>
+inline void DualPool<Element, FIXED_SIZE>::flip() {
 	std::swap(m_primary, m_secondary);
 }
 
-template<typename Element>
-inline Element & DualPool<Element>::primary(unsigned int i) {
+template<typename Element, unsigned int FIXED_SIZE>
+inline Element & DualPool<Element, FIXED_SIZE>::primary(unsigned int i) {
 	return m_primary[i];
 }
 
-template<typename Element>
-inline Element & DualPool<Element>::secondary(unsigned int i) {
+template<typename Element, unsigned int FIXED_SIZE>
+inline Element & DualPool<Element, FIXED_SIZE>::secondary(unsigned int i) {
 	return m_secondary[i];
 }
 
-template<typename Element>
-inline Element *DualPool<Element>::primaryPtr(unsigned int i) {
+template<typename Element, unsigned int FIXED_SIZE>
+inline Element *DualPool<Element, FIXED_SIZE>::primaryPtr(unsigned int i) {
 	return &m_primary[i];
 }
 
-template<typename Element>
-inline Element *DualPool<Element>::secondaryPtr(unsigned int i) {
+template<typename Element, unsigned int FIXED_SIZE>
+inline Element *DualPool<Element, FIXED_SIZE>::secondaryPtr(unsigned int i) {
 	return &m_secondary[i];
 }
 
+template<typename Element, unsigned int FIXED_SIZE>
+template<typename Evaluator>
+inline void DualPool<Element, FIXED_SIZE>::initNodes(Evaluator& evaluator) {
+	for(unsigned int i = 0; i < 2 * size(); i++) {
+		evaluator.initNode(m_pool[i]);
+	}
+}
+
+template<typename Element, unsigned int FIXED_SIZE>
+inline void DualPool<Element, FIXED_SIZE>::setPrimary(unsigned int i,
+													  const Element& element) {
+	m_primary[i] = element;
+}
+
+template<typename Element, unsigned int FIXED_SIZE>
+inline Element *DualPool<Element, FIXED_SIZE>::childSlots(unsigned int first,
+														  unsigned int n) {
+	// Children are written directly into the secondary pool
+	return &m_secondary[first];
+}
+
+template<typename Element, unsigned int FIXED_SIZE>
+inline void DualPool<Element, FIXED_SIZE>::commitChildren(unsigned int first,
+														  unsigned int n)
+{}
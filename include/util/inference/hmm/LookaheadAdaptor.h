@@ -4,12 +4,30 @@
  */
 #pragma once
 
+#include <stddef.h>
 #include <vector>
+#include <list>
+#include <algorithm>
+#include "BeamSearch.h" // For SearchIntermediateResult, HasBranchAll
+#include "WeightTraits.h"
 
 /**
  * \ingroup hmm
  * \brief A branching process that looks ahead a few layers in the tree when estimating node
  *     likelihoods.
+ *
+ * Every node holds a wavefront of 2^(logBranchFactor * lookaheadDepth)
+ *     underlying nodes. Wavefronts are not allocated by the nodes: initNode()
+ *     gives each node a wavefront in an arena owned by the adaptor, so the
+ *     wavefronts of a node pool lie next to each other, and nodes are
+ *     branched without heap allocations.
+ *
+ * When the underlying evaluator has branchAll(), each wavefront node's
+ *     children are evaluated in one call.
+ *
+ * The arena grows in blocks, each as large as all blocks before it, and
+ *     blocks are never moved, so a node's wavefront stays in place while the
+ *     adaptor exists. A copy of the adaptor starts with an empty arena.
  */
 template<typename BranchEvaluator>
 class LookaheadAdaptor {
@@ -17,10 +35,37 @@ public:
 	typedef typename BranchEvaluator::Weight Weight;
 	typedef typename BranchEvaluator::BranchData BranchData;
 
+	// Weights are renormalized if the underlying evaluator's are
+	enum { RENORMALIZE_WEIGHTS = RenormalizesWeights<BranchEvaluator>::value };
+
 	/**
 	 * The Node struct keeps information on one node in the explored tree
+	 *
+	 * A node that went through initNode() owns a wavefront in the arena, and
+	 *     assigning to it copies the other node's wavefront into its own.
+	 *     Other nodes (default constructed or copy constructed) only refer to
+	 *     the wavefront of the node they were made from, so taking them does
+	 *     not copy wavefronts. They are valid until that node changes.
 	 */
 	struct Node {
+		Node() : minWeight(0), nodes(NULL), wavefrontSize(0) {}
+
+		Node(const Node& other)
+			: minWeight(other.minWeight),
+			  nodes(other.nodes),
+			  wavefrontSize(0) {}
+
+		Node& operator=(const Node& other) {
+			minWeight = other.minWeight;
+			if(wavefrontSize == 0) {
+				// Not in the arena, refer to the other node's wavefront
+				nodes = other.nodes;
+			} else if(nodes != other.nodes) {
+				std::copy(other.nodes, other.nodes + wavefrontSize, nodes);
+			}
+			return *this;
+		}
+
 		/**
 		 * Returns the likelihood
 		 */
@@ -28,7 +73,13 @@ public:
 		typename BranchEvaluator::Node& lookaheadRoot() {return nodes[0];}
 
 		Weight minWeight;
-		std::vector<typename BranchEvaluator::Node> nodes;
+
+		// The wavefront
+		typename BranchEvaluator::Node* nodes;
+
+		// The number of nodes in the wavefront if the node owns it, 0 if it
+		// refers to another node's wavefront
+		unsigned int wavefrontSize;
 	};
 
 	/**
@@ -39,16 +90,31 @@ public:
 							 unsigned int logBranchFactor,
 							 unsigned int lookaheadDepth);
 
+	/**
+	 * Copy c'tor
+	 *
+	 * @important The copy starts with an empty arena; nodes initialized by
+	 *     'other' still use the arena of 'other'.
+	 */
+	LookaheadAdaptor(const LookaheadAdaptor& other);
+
 	/**
 	 * Branches the wavefront
 	 */
 	void branch(Node& parent, unsigned int edge, BranchData& data, Node& child);
 
 
+	/**
+	 * Subtracts 'offset' from the weights of all nodes in the wavefront. Only
+	 *     used if the underlying evaluator renormalizes weights.
+	 */
+	void renormalize(Node& node, Weight offset);
+
 	/**
 	 * Initializes Node objects for the first time. This is instead of using a
 	 *     factory (in order to avoid pointer dereferences). initNode should
-	 *     be called once on each node, after its construction.
+	 *     be called once on each node, after its construction. The node's
+	 *     wavefront is taken from the arena.
 	 *
 	 * When starting a new decode, do NOT call initNode again.
 	 */
@@ -88,6 +154,25 @@ public:
 	BranchEvaluator& encapsulatedBranchEvaluator();
 
 private:
+	// Selects a branching strategy at compile time
+	template<bool value> struct BoolTag {};
+
+	/**
+	 * Evaluates the children of wavefront nodes parentNodes[0..n-1] into
+	 *     childNodes[0..n*branchFactor-1], using the underlying evaluator's
+	 *     branchAll() if it has one, and branch() for every child otherwise.
+	 */
+	void branchWavefront(typename BranchEvaluator::Node* parentNodes,
+						 unsigned int n,
+						 BranchData& data,
+						 typename BranchEvaluator::Node* childNodes,
+						 BoolTag<true>);
+	void branchWavefront(typename BranchEvaluator::Node* parentNodes,
+						 unsigned int n,
+						 BranchData& data,
+						 typename BranchEvaluator::Node* childNodes,
+						 BoolTag<false>);
+
 	/**
 	 * Given an index into the nodes vector, adds the part of the path due to
 	 *     the lookahead into the given vector.
@@ -97,6 +182,11 @@ private:
 	 */
 	void addPathFromIndex(unsigned int index, vector<unsigned short>& path);
 
+	/**
+	 * @return a wavefront from the arena, adding a block if needed
+	 */
+	typename BranchEvaluator::Node* allocateWavefront();
+
 	// The branch evaluator used to branch nodes
 	BranchEvaluator m_underlyingBranchEvaluator;
 
@@ -121,7 +211,14 @@ private:
 	// A mask to only get the bits up to m_logBranchFactor
 	const unsigned int m_branchMask;
 
+	// The number of wavefronts in the arena's first block
+	enum { MIN_BLOCK_WAVEFRONTS = 16 };
+
+	// The arena's blocks of wavefronts
+	std::list<std::vector<typename BranchEvaluator::Node> > m_arena;
 
+	// The number of wavefronts given out from the last block
+	unsigned int m_numUsedInBlock;
 };
 
 
@@ -144,7 +241,22 @@ inline LookaheadAdaptor<BranchEvaluator>::LookaheadAdaptor(
     m_wavefrontSize(1 << (m_logBranchFactor * m_lookaheadDepth)),
     m_branchFactor(1 << m_logBranchFactor),
     m_wavefrontMask(m_wavefrontSize - 1),
-    m_branchMask(m_branchFactor - 1)
+    m_branchMask(m_branchFactor - 1),
+    m_numUsedInBlock(0)
+{}
+
+template<typename BranchEvaluator>
+inline LookaheadAdaptor<BranchEvaluator>::LookaheadAdaptor(
+		const LookaheadAdaptor & other)
+  : m_underlyingBranchEvaluator(other.m_underlyingBranchEvaluator),
+    m_logBranchFactor(other.m_logBranchFactor),
+    m_lookaheadDepth(other.m_lookaheadDepth),
+    m_logWavefrontSize(other.m_logWavefrontSize),
+    m_wavefrontSize(other.m_wavefrontSize),
+    m_branchFactor(other.m_branchFactor),
+    m_wavefrontMask(other.m_wavefrontMask),
+    m_branchMask(other.m_branchMask),
+    m_numUsedInBlock(0)
 {}
 
 template<typename BranchEvaluator>
@@ -154,39 +266,85 @@ inline void LookaheadAdaptor<BranchEvaluator>::branch(
 		BranchData& data,
 		Node & child)
 {
-	assert(parent.nodes.size() == m_wavefrontSize);
-	assert(child.nodes.size() == m_wavefrontSize);
+	assert(parent.nodes != NULL);
+	assert(child.wavefrontSize == m_wavefrontSize);
 	assert(edge < m_branchFactor);
 
-	// the variable ind contains, in the upper bits, the index of the parent
-	// node to branched from. In the lower bits, it contains the child bits
-	// to be branched.
-	unsigned int ind = edge << (m_logWavefrontSize);
-
-	m_underlyingBranchEvaluator.branch(parent.nodes[ind >> m_logBranchFactor],
-									   ind & m_branchMask,
-									   data,
-									   child.nodes[0]);
-	ind++;
+	typename BranchEvaluator::Node* childNodes = child.nodes;
 
-	Weight minWeight = child.nodes[0].getWeight();
+	if(m_lookaheadDepth == 0) {
+		// The wavefront is just the node, no looking ahead
+		m_underlyingBranchEvaluator.branch(parent.nodes[0], edge, data, childNodes[0]);
+		child.minWeight = childNodes[0].getWeight();
+		return;
+	}
 
-	for (; (ind & m_wavefrontMask) != 0; ind++) {
-		m_underlyingBranchEvaluator.branch(parent.nodes[ind >> m_logBranchFactor],
-										   ind & m_branchMask,
-										   data,
-										   child.nodes[ind & m_wavefrontMask]);
+	// Child wavefront node i is child (i & m_branchMask) of parent
+	// wavefront node ((edge << m_logWavefrontSize) + i) >> m_logBranchFactor,
+	// so the children of consecutive parent nodes are consecutive.
+	branchWavefront(parent.nodes + (edge << (m_logWavefrontSize - m_logBranchFactor)),
+					m_wavefrontSize >> m_logBranchFactor,
+					data,
+					childNodes,
+					BoolTag<HasBranchAll<BranchEvaluator>::value>());
 
-		minWeight = min(minWeight, child.nodes[ind & m_wavefrontMask].getWeight());
+	Weight minWeight = childNodes[0].getWeight();
+	for (unsigned int i = 1; i < m_wavefrontSize; i++) {
+		minWeight = min(minWeight, childNodes[i].getWeight());
 	}
 
 	child.minWeight = minWeight;
 }
 
+template<typename BranchEvaluator>
+inline void LookaheadAdaptor<BranchEvaluator>::branchWavefront(
+		typename BranchEvaluator::Node* parentNodes,
+		unsigned int n,
+		BranchData& data,
+		typename BranchEvaluator::Node* childNodes,
+		BoolTag<true>)
+{
+	for (unsigned int i = 0; i < n; i++) {
+		m_underlyingBranchEvaluator.branchAll(parentNodes[i],
+											  data,
+											  childNodes + (i << m_logBranchFactor));
+	}
+}
+
+template<typename BranchEvaluator>
+inline void LookaheadAdaptor<BranchEvaluator>::branchWavefront(
+		typename BranchEvaluator::Node* parentNodes,
+		unsigned int n,
+		BranchData& data,
+		typename BranchEvaluator::Node* childNodes,
+		BoolTag<false>)
+{
+	for (unsigned int i = 0; i < n; i++) {
+		for (unsigned int j = 0; j < m_branchFactor; j++) {
+			m_underlyingBranchEvaluator.branch(parentNodes[i],
+											   j,
+											   data,
+											   childNodes[(i << m_logBranchFactor) + j]);
+		}
+	}
+}
+
+template<typename BranchEvaluator>
+inline void LookaheadAdaptor<BranchEvaluator>::renormalize(Node & node,
+														   Weight offset)
+{
+	node.minWeight -= offset;
+
+	for (unsigned int i = 0; i < m_wavefrontSize; i++) {
+		m_underlyingBranchEvaluator.renormalize(node.nodes[i], offset);
+	}
+}
+
 template<typename BranchEvaluator>
 inline void LookaheadAdaptor<BranchEvaluator>::initNode(Node & node) {
 
-	node.nodes.resize(m_wavefrontSize);
+	node.nodes = allocateWavefront();
+	node.wavefrontSize = m_wavefrontSize;
 
 	for (unsigned int i = 0; i < m_wavefrontSize; i++) {
 		m_underlyingBranchEvaluator.initNode(node.nodes[i]);
@@ -225,7 +383,7 @@ LookaheadAdaptor<BranchEvaluator>::addMostLikelyPath(
 		vector<unsigned short> & path)
 {
 	unsigned int minIndex =
-			min_element(node.nodes.begin(), node.nodes.end()) - node.nodes.begin();
+			min_element(node.nodes, node.nodes + m_wavefrontSize) - node.nodes;
 
 	addPathFromIndex(minIndex, path);
 
@@ -266,4 +424,26 @@ inline void LookaheadAdaptor<BranchEvaluator>::addPathFromIndex(
 	}
 }
 
+template<typename BranchEvaluator>
+inline typename BranchEvaluator::Node *
+LookaheadAdaptor<BranchEvaluator>::allocateWavefront()
+{
+	if(m_arena.empty()
+			|| (m_numUsedInBlock * m_wavefrontSize == m_arena.back().size())) {
+		// Each block holds as many wavefronts as all previous blocks
+		// together, and at least MIN_BLOCK_WAVEFRONTS
+		unsigned int numWavefronts = 0;
+		typename std::list<std::vector<typename BranchEvaluator::Node> >::iterator it;
+		for(it = m_arena.begin(); it != m_arena.end(); it++) {
+			numWavefronts += it->size() / m_wavefrontSize;
+		}
+		numWavefronts = std::max(numWavefronts,
+								 (unsigned int)MIN_BLOCK_WAVEFRONTS);
 
+		m_arena.push_back(std::vector<typename BranchEvaluator::Node>());
+		m_arena.back().resize(numWavefronts * m_wavefrontSize);
+		m_numUsedInBlock = 0;
+	}
+
+	return &m_arena.back()[m_numUsedInBlock++ * m_wavefrontSize];
+}
@@ -98,6 +98,23 @@ public:
 	void getIntermediate(
 			std::vector<SearchIntermediateResult<Node> >& interm);
 
+	/**
+	 * Enables or disables checkpointing, @see BeamSearch::setCheckpointing
+	 */
+	void setCheckpointing(bool enable);
+
+	/**
+	 * Rewinds the search, @see BeamSearch::rewind
+	 *
+	 * @note the root is updated in-place during the first lookaheadDepth
+	 *     layers, so rewinding into those layers returns 0.
+	 */
+	unsigned int rewind(unsigned int depth);
+
+	/**
+	 * Limits backtracking memory, @see BeamSearch::setTracebackWindow
+	 */
+	void setTracebackWindow(unsigned int numLayers);
 
 private:
 	typedef LookaheadAdaptor<BranchEvaluator> Adaptor;
@@ -218,6 +235,43 @@ inline void LookaheadBeamSearch<BranchEvaluator,Pruner>::getIntermediate(
 	}
 }
 
+template<typename BranchEvaluator, template<class> class Pruner>
+inline void LookaheadBeamSearch<BranchEvaluator,Pruner>::setCheckpointing(
+		bool enable)
+{
+	m_lookaheadBeamSearch.setCheckpointing(enable);
+}
+
+template<typename BranchEvaluator, template<class> class Pruner>
+inline unsigned int LookaheadBeamSearch<BranchEvaluator,Pruner>::rewind(
+		unsigned int depth)
+{
+	if(depth >= m_layer) {
+		return m_layer;
+	}
+
+	if(depth <= m_lookaheadDepth) {
+		// The root wavefront was overwritten, cannot restore it
+		return 0;
+	}
+
+	unsigned int innerDepth =
+			m_lookaheadBeamSearch.rewind(depth - m_lookaheadDepth);
+	if(innerDepth == 0) {
+		return 0;
+	}
+
+	m_layer = innerDepth + m_lookaheadDepth;
+	return m_layer;
+}
+
+template<typename BranchEvaluator, template<class> class Pruner>
+inline void LookaheadBeamSearch<BranchEvaluator,Pruner>::setTracebackWindow(
+		unsigned int numLayers)
+{
+	m_lookaheadBeamSearch.setTracebackWindow(numLayers);
+}
+
 template<typename BranchEvaluator, template<class> class Pruner>
 inline typename LookaheadBeamSearch<BranchEvaluator,Pruner>::Adaptor &
 LookaheadBeamSearch<BranchEvaluator,Pruner>::adaptor()
@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * \ingroup hmm
+ * \brief Maps weights to unsigned integer keys with the same order, so
+ *    weights can be compared by their bits.
+ */
+template<typename Weight>
+struct RadixKey;
+
+template<>
+struct RadixKey<uint16_t> {
+	typedef uint16_t Key;
+	static Key key(uint16_t weight) { return weight; }
+};
+
+template<>
+struct RadixKey<uint32_t> {
+	typedef uint32_t Key;
+	static Key key(uint32_t weight) { return weight; }
+};
+
+template<>
+struct RadixKey<uint64_t> {
+	typedef uint64_t Key;
+	static Key key(uint64_t weight) { return weight; }
+};
+
+template<>
+struct RadixKey<float> {
+	typedef uint32_t Key;
+	static Key key(float weight) {
+		Key bits;
+		memcpy(&bits, &weight, sizeof(bits));
+		// Negative numbers are ordered in reverse, so all their bits are
+		// flipped; positive numbers only need to be above negative ones
+		return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+	}
+};
+
+template<>
+struct RadixKey<double> {
+	typedef uint64_t Key;
+	static Key key(double weight) {
+		Key bits;
+		memcpy(&bits, &weight, sizeof(bits));
+		return (bits & 0x8000000000000000ull) ? ~bits
+											   : (bits | 0x8000000000000000ull);
+	}
+};
+
+/**
+ * \ingroup hmm
+ * \brief Keeps the K minimal weight elements, selecting them from a flat
+ *    buffer with a radix select.
+ *
+ * RadixSelectBestK has the same interface as BestK and can replace it as a
+ *    pruner. Instead of keeping a heap, pushed elements are appended to a
+ *    buffer. When the buffer holds 2K elements, the best K are selected by a
+ *    radix select over the bits of their weights, in linear time, and the
+ *    weight of the K'th element becomes a threshold that later pushes must
+ *    beat.
+ *
+ * The selected elements are not sorted: putSorted() only places the minimal
+ *    element first. Among elements of equal weight, ones that were pushed
+ *    earlier are kept, as in BestK.
+ *
+ * The template argument, Datum, has to meet these requirements:
+ * 1. It should define a Datum::Weight type, with a RadixKey specialization.
+ * 2. It should implement a Datum::weight member, containing the weight.
+ */
+template<typename Datum>
+class RadixSelectBestK {
+public:
+	typedef unsigned int Params;
+	typedef typename Datum::Weight Weight;
+
+	/**
+	 * C'tor
+	 * @param k: the maximum number of elements to keep
+	 */
+	RadixSelectBestK(unsigned int k);
+
+	/**
+	 * Attempts to add the given datum.
+	 */
+	void push(const Datum& datum);
+
+	/**
+	 * Returns the weight of the datum with maximum weight within the best k
+	 *
+	 * If the RadixSelectBestK is empty, the result is undefined
+	 */
+	Weight maxWeight();
+
+	/**
+	 * Checks whether a value with weight might be pushed if push() is called
+	 *
+	 * @return true if value might be pushed, false otherwise
+	 */
+	bool checkPush(Weight weight);
+
+	/**
+	 * Returns the current number of elements in the RadixSelectBestK.
+	 */
+	unsigned int size();
+
+	/**
+	 * @return the maximum possible number of elements that could be kept
+	 */
+	uint32_t maxSize();
+
+	/**
+	 * Moves the datums into the destination vector, with the datum of minimal
+	 *     weight first. The other datums are in no particular order. The
+	 *     RadixSelectBestK is reset at the end.
+	 */
+	void putSorted(std::vector<Datum>& dest);
+
+private:
+	typedef typename RadixKey<Weight>::Key Key;
+
+	/**
+	 * Keeps only the best m_k elements in the buffer, and updates the
+	 *     threshold
+	 */
+	void select();
+
+	/**
+	 * @return the k'th smallest key in m_keys (k is 1-based)
+	 */
+	Key kthKey(unsigned int k);
+
+	// Number of items to keep
+	const unsigned int m_k;
+
+	// Pushed elements that were not yet pruned, and their keys
+	std::vector<Datum> m_data;
+	std::vector<Key> m_keys;
+
+	// Buffers for the radix select
+	std::vector<Key> m_candidates;
+	std::vector<Key> m_nextCandidates;
+
+	// True if m_threshold is valid, i.e. m_k elements have been kept
+	bool m_hasThreshold;
+
+	// The weight of the worst kept element. Pushes must have lower weight.
+	Weight m_threshold;
+};
+
+
+#include <algorithm>
+
+template<typename Datum>
+inline RadixSelectBestK<Datum>::RadixSelectBestK(unsigned int k)
+  : m_k(k),
+    m_hasThreshold(false),
+    m_threshold(0)
+{
+	m_data.reserve(2 * m_k);
+	m_keys.reserve(2 * m_k);
+	m_candidates.reserve(2 * m_k);
+	m_nextCandidates.reserve(2 * m_k);
+}
+
+template<typename Datum>
+inline void RadixSelectBestK<Datum>::push(const Datum & datum) {
+	if(m_hasThreshold && !(datum.weight < m_threshold)) {
+		return;
+	}
+
+	m_data.push_back(datum);
+	m_keys.push_back(RadixKey<Weight>::key(datum.weight));
+
+	if(m_data.size() == 2 * m_k) {
+		select();
+	}
+}
+
+template<typename Datum>
+inline typename RadixSelectBestK<Datum>::Weight
+RadixSelectBestK<Datum>::maxWeight() {
+	if(m_data.size() > m_k) {
+		select();
+	}
+
+	Weight maxWeight = m_data[0].weight;
+	for(unsigned int i = 1; i < m_data.size(); i++) {
+		maxWeight = std::max(maxWeight, m_data[i].weight);
+	}
+	return maxWeight;
+}
+
+template<typename Datum>
+inline bool RadixSelectBestK<Datum>::checkPush(Weight weight) {
+	return (!m_hasThreshold) || (weight < m_threshold);
+}
+
+template<typename Datum>
+inline unsigned int RadixSelectBestK<Datum>::size() {
+	return std::min((unsigned int)m_data.size(), m_k);
+}
+
+template<typename Datum>
+inline uint32_t RadixSelectBestK<Datum>::maxSize() {
+	return m_k;
+}
+
+template<typename Datum>
+inline void RadixSelectBestK<Datum>::putSorted(std::vector<Datum> & dest)
+{
+	if(m_data.size() > m_k) {
+		select();
+	}
+
+	dest.assign(m_data.begin(), m_data.end());
+
+	// Only the best element needs to be in place
+	if(!dest.empty()) {
+		std::iter_swap(dest.begin(), std::min_element(dest.begin(), dest.end()));
+	}
+
+	m_data.clear();
+	m_keys.clear();
+	m_hasThreshold = false;
+}
+
+template<typename Datum>
+inline void RadixSelectBestK<Datum>::select()
+{
+	Key threshold = kthKey(m_k);
+
+	// Count the elements strictly below the threshold; the rest of the k
+	// places go to elements equal to the threshold, earliest first
+	unsigned int numBelow = 0;
+	for(unsigned int i = 0; i < m_keys.size(); i++) {
+		numBelow += (m_keys[i] < threshold);
+	}
+	unsigned int numEqual = m_k - numBelow;
+
+	unsigned int numKept = 0;
+	for(unsigned int i = 0; i < m_keys.size(); i++) {
+		bool keep = (m_keys[i] < threshold);
+		if((!keep) && (m_keys[i] == threshold) && (numEqual > 0)) {
+			keep = true;
+			numEqual--;
+		}
+		if(keep) {
+			m_data[numKept] = m_data[i];
+			m_keys[numKept] = m_keys[i];
+			numKept++;
+		}
+	}
+	m_data.erase(m_data.begin() + numKept, m_data.end());
+	m_keys.erase(m_keys.begin() + numKept, m_keys.end());
+
+	// The worst kept element has the threshold key
+	for(unsigned int i = 0; i < numKept; i++) {
+		if(m_keys[i] == threshold) {
+			m_threshold = m_data[i].weight;
+			break;
+		}
+	}
+	m_hasThreshold = true;
+}
+
+template<typename Datum>
+inline typename RadixSelectBestK<Datum>::Key
+RadixSelectBestK<Datum>::kthKey(unsigned int k)
+{
+	// The key is found one byte at a time, from the most significant byte.
+	// Each pass keeps only the candidates whose byte falls in the bucket
+	// that contains the k'th key.
+	m_candidates.assign(m_keys.begin(), m_keys.end());
+	Key result = 0;
+
+	for(int shift = 8 * (sizeof(Key) - 1); shift >= 0; shift -= 8) {
+		unsigned int histogram[256];
+		std::fill(histogram, histogram + 256, 0);
+		for(unsigned int i = 0; i < m_candidates.size(); i++) {
+			histogram[(m_candidates[i] >> shift) & 0xFF]++;
+		}
+
+		unsigned int bucket = 0;
+		while(k > histogram[bucket]) {
+			k -= histogram[bucket];
+			bucket++;
+		}
+		result |= (Key(bucket) << shift);
+
+		if(histogram[bucket] == m_candidates.size()) {
+			// All candidates are in the bucket, no need to filter
+			continue;
+		}
+
+		m_nextCandidates.clear();
+		for(unsigned int i = 0; i < m_candidates.size(); i++) {
+			if(((m_candidates[i] >> shift) & 0xFF) == bucket) {
+				m_nextCandidates.push_back(m_candidates[i]);
+			}
+		}
+		m_candidates.swap(m_nextCandidates);
+	}
+
+	return result;
+}
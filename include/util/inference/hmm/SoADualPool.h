@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <vector>
+
+/**
+ * \ingroup hmm
+ * \brief Describes how a node is split into separate fields, for SoADualPool.
+ *
+ * Node types stored in a SoADualPool specialize this struct. A specialization
+ *    defines the field types Weight, Seed and Extra, and the methods:
+ *
+ *    static Weight weight(const Node& node);
+ *    static Seed seed(const Node& node);
+ *    static Extra extra(const Node& node);
+ *    static void assemble(Weight weight, Seed seed, Extra extra, Node& node);
+ */
+template<typename Node>
+struct SoANodeTraits;
+
+/**
+ * \ingroup hmm
+ * \brief A DualPool that stores each field of its nodes in a separate array.
+ *
+ * The pool has the same interface as DualPool, but keeps a structure of
+ *    arrays: the weights of all nodes in a pool are contiguous, as are their
+ *    seeds and their extra fields. A pass that only reads weights then only
+ *    brings weights into the cache.
+ *
+ * Nodes are not stored as objects, so:
+ *   - primary(i) returns a node assembled from the fields. The reference
+ *     is valid until the next call to primary(), and changing it does not
+ *     change the pool; use setPrimary() instead.
+ *   - Children are written to a scratch buffer returned by childSlots(), and
+ *     are split into the secondary pool's arrays by commitChildren().
+ *   - Nodes must not need initialization with initNode(). initNodes() is a
+ *     no-op.
+ */
+template<typename Node, unsigned int FIXED_SIZE = 0>
+class SoADualPool {
+public:
+	typedef SoANodeTraits<Node> Traits;
+	typedef typename Traits::Weight Weight;
+	typedef typename Traits::Seed Seed;
+	typedef typename Traits::Extra Extra;
+
+	/**
+	 * c'tor
+	 * @param poolSize: the size of each pool.
+	 */
+	SoADualPool(unsigned int poolSize);
+
+	/**
+	 * Copy c'tor
+	 *
+	 * @important The copy constructor only copies the pool structure, not
+	 *    the individual elements!
+	 */
+	SoADualPool(const SoADualPool& other);
+
+	/**
+	 * @return the size of each pool
+	 */
+	unsigned int size();
+
+	/**
+	 * Changes primary pool to be secondary, and secondary to primary
+	 */
+	void flip();
+
+	/**
+	 * @return node i of the primary pool, assembled from its fields
+	 */
+	Node& primary(unsigned int i);
+
+	/**
+	 * Does nothing; nodes are rebuilt from their fields
+	 */
+	template<typename Evaluator>
+	void initNodes(Evaluator& evaluator) {}
+
+	/**
+	 * Sets node i of the primary pool
+	 */
+	void setPrimary(unsigned int i, const Node& node);
+
+	/**
+	 * Returns a buffer for 'n' nodes, to become secondary nodes
+	 *     first..first+n-1 when commitChildren() is called.
+	 */
+	Node* childSlots(unsigned int first, unsigned int n);
+
+	/**
+	 * Splits the nodes written to childSlots(first, n) into the secondary
+	 *     pool's arrays
+	 */
+	void commitChildren(unsigned int first, unsigned int n);
+
+	/**
+	 * Accessors to the contiguous fields of each pool
+	 */
+	const Weight* primaryWeights();
+	const Weight* secondaryWeights();
+	const Seed* primarySeeds();
+	const Seed* secondarySeeds();
+
+private:
+	// The fields of all nodes in one pool
+	struct Fields {
+		Fields(unsigned int poolSize)
+			: weights(poolSize), seeds(poolSize), extras(poolSize) {}
+
+		std::vector<Weight> weights;
+		std::vector<Seed> seeds;
+		std::vector<Extra> extras;
+	};
+
+	/**
+	 * Writes 'node' into entry i of 'fields'
+	 */
+	static void store(Fields& fields, unsigned int i, const Node& node);
+
+	unsigned int m_size;
+
+	// The two pools
+	Fields m_first;
+	Fields m_second;
+
+	// Pointer to primary pool
+	Fields* m_primary;
+
+	// Pointer to secondary pool
+	Fields* m_secondary;
+
+	// The node returned by primary()
+	Node m_node;
+
+	// Children before they are split into fields
+	std::vector<Node> m_children;
+};
+
+
+#include <algorithm>
+#include <stdexcept>
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline SoADualPool<Node, FIXED_SIZE>::SoADualPool(unsigned int poolSize)
+	:m_size(poolSize),
+	 m_first(m_size),
+	 m_second(m_size),
+	 m_primary(&m_first),
+	 m_secondary(&m_second)
+{
+	if((FIXED_SIZE != 0) && (m_size != FIXED_SIZE)) {
+		throw(std::runtime_error("Pool size does not match its fixed size"));
+	}
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline SoADualPool<Node, FIXED_SIZE>::SoADualPool(const SoADualPool & other)
+:m_size(other.m_size),
+ m_first(m_size),
+ m_second(m_size),
+ m_primary(&m_first),
+ m_secondary(&m_second)
+{}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline unsigned int SoADualPool<Node, FIXED_SIZE>::size() {
+	return (FIXED_SIZE != 0) ? FIXED_SIZE : m_size;
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline void SoADualPool<Node, FIXED_SIZE>::flip() {
+	std::swap(m_primary, m_secondary);
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline Node & SoADualPool<Node, FIXED_SIZE>::primary(unsigned int i) {
+	Traits::assemble(m_primary->weights[i],
+					 m_primary->seeds[i],
+					 m_primary->extras[i],
+					 m_node);
+	return m_node;
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline void SoADualPool<Node, FIXED_SIZE>::setPrimary(unsigned int i,
+													  const Node& node) {
+	store(*m_primary, i, node);
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline Node *SoADualPool<Node, FIXED_SIZE>::childSlots(unsigned int first,
+													   unsigned int n) {
+	if(m_children.size() < n) {
+		m_children.resize(n);
+	}
+	return &m_children[0];
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline void SoADualPool<Node, FIXED_SIZE>::commitChildren(unsigned int first,
+														  unsigned int n) {
+	for(unsigned int i = 0; i < n; i++) {
+		store(*m_secondary, first + i, m_children[i]);
+	}
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline const typename SoADualPool<Node, FIXED_SIZE>::Weight *
+SoADualPool<Node, FIXED_SIZE>::primaryWeights() {
+	return &m_primary->weights[0];
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline const typename SoADualPool<Node, FIXED_SIZE>::Weight *
+SoADualPool<Node, FIXED_SIZE>::secondaryWeights() {
+	return &m_secondary->weights[0];
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline const typename SoADualPool<Node, FIXED_SIZE>::Seed *
+SoADualPool<Node, FIXED_SIZE>::primarySeeds() {
+	return &m_primary->seeds[0];
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline const typename SoADualPool<Node, FIXED_SIZE>::Seed *
+SoADualPool<Node, FIXED_SIZE>::secondarySeeds() {
+	return &m_secondary->seeds[0];
+}
+
+template<typename Node, unsigned int FIXED_SIZE>
+inline void SoADualPool<Node, FIXED_SIZE>::store(Fields& fields,
+												 unsigned int i,
+												 const Node& node) {
+	fields.weights[i] = Traits::weight(node);
+	fields.seeds[i] = Traits::seed(node);
+	fields.extras[i] = Traits::extra(node);
+}
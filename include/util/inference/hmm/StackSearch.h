@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "BeamSearch.h" // For SearchIntermediateResult and HasBranchAll
+#include "WeightTraits.h"
+
+/**
+ * \ingroup hmm
+ * \brief A best-first (stack) sequential search of a tree.
+ *
+ * Instead of branching every node in a beam, the search keeps all explored
+ *    nodes in a priority queue, and always branches the most promising one.
+ *    When the symbols are clean, the correct path is almost always the most
+ *    promising, so only a few nodes are branched per depth.
+ *
+ * Nodes of different depths are compared with a Fano-style metric: a node's
+ *    priority is its weight minus 'bias' times the weight the correct path is
+ *    expected to have at the node's depth. The expected weight of every step
+ *    is given with setExpectedStepWeight() before each advance(). The correct
+ *    path's priority then stays around 0, while wrong paths quickly grow
+ *    heavier. A bias above 1 makes the search prefer deeper nodes, branching
+ *    fewer nodes at the risk of following wrong paths further.
+ *
+ * advance() extends the search by one depth: it branches nodes until the most
+ *    promising node is at the new depth. Nodes that were not branched stay in
+ *    the queue, and might be branched in later calls to advance(), so the
+ *    search keeps the BranchData of all depths. The best path is always the
+ *    path to the most promising node at the deepest depth.
+ *
+ * Nodes are allocated from an arena that is allocated once, at construction.
+ *    The children of a node are allocated together, and each group of
+ *    children keeps the index of its parent, which is enough to recover paths
+ *    from the root.
+ *
+ * The search branches at most 'maxNumNodes' nodes' worth of children in a
+ *    search. When the budget runs out, the search continues greedily: at
+ *    every remaining depth it only branches the best node of the previous
+ *    depth.
+ *
+ * Weights must be absolute, so evaluators that renormalize weights (see
+ *    RenormalizesWeights) are not supported. The search cannot be rewound.
+ */
+template<typename BranchEvaluator>
+class StackSearch {
+public:
+	typedef BranchEvaluator Evaluator;
+	typedef typename BranchEvaluator::Node Node;
+	typedef typename BranchEvaluator::Weight Weight;
+	typedef typename BranchEvaluator::BranchData BranchData;
+
+	// Tells the decoder to call setExpectedStepWeight() (see UsesExpectedWeights)
+	enum { USES_EXPECTED_WEIGHTS = 1 };
+
+	/**
+	 * C'tor
+	 * @param maxNumNodes: the maximum number of nodes the search makes before
+	 *     continuing greedily
+	 * @param bias: the factor multiplying the expected weight of the correct
+	 *     path, when computing priorities
+	 * @param maxSearchDepth: the maximum depth of the search tree that is
+	 *     explored
+	 * @param branchEvaluator: The class used to get a child node, from parent.
+	 * @param logBranchFactor: The log of number of children each node has
+	 */
+	StackSearch(unsigned int maxNumNodes,
+				double bias,
+				unsigned int maxSearchDepth,
+				const BranchEvaluator& branchEvaluator,
+				unsigned int logBranchFactor);
+
+	/**
+	 * Returns a reference to the branch evaluator.
+	 */
+	BranchEvaluator& branchEvaluator();
+
+	/**
+	 * Initializes a new search.
+	 */
+	void initialize();
+
+	/**
+	 * @return A reference to the root node. The root node should be initialized
+	 *     by the caller.
+	 * @note the return value of this method is only valid after
+	 *     initialize() and before any calls to advance()
+	 */
+	Node& getRoot();
+
+	/**
+	 * Sets the weight that the correct path is expected to gain in the next
+	 *     call to advance(), e.g., the expected noise energy of the symbols
+	 *     in branchData. Defaults to 0.
+	 */
+	void setExpectedStepWeight(double weight);
+
+	/**
+	 * Extends the search by one depth, using the symbols in branchData for
+	 *     branches out of nodes at the current depth.
+	 *
+	 * @note branchData must remain valid until the next initialize()
+	 */
+	void advance(BranchData& branchData);
+
+	/**
+	 * Gets the best path explored by the search so far.
+	 *
+	 * @param bestPath: [out] the index of the branch taken, in a path from
+	 *     the root to the best node at the deepest depth.
+	 * @return: reference to the best node
+	 */
+	Node& getBestPath(std::vector<unsigned short>& bestPath);
+
+	/**
+	 * Returns all nodes at the deepest depth, along with their paths. The
+	 *     best node comes first.
+	 */
+	void getIntermediate(
+			std::vector<SearchIntermediateResult<Node> >& interm);
+
+	/**
+	 * The search cannot be rewound, so checkpointing is not supported, and
+	 *     this method does nothing.
+	 */
+	void setCheckpointing(bool enable);
+
+	/**
+	 * @return the current depth if 'depth' is not smaller than it, and 0
+	 *     otherwise, since the search cannot be rewound.
+	 */
+	unsigned int rewind(unsigned int depth);
+
+	/**
+	 * The search recovers paths through its node arena, whose size does not
+	 *     depend on a window, so this method does nothing.
+	 */
+	void setTracebackWindow(unsigned int numLayers);
+
+	/**
+	 * @return the number of nodes made since the last initialize(), including
+	 *     the root
+	 */
+	unsigned int numNodes() const;
+
+private:
+	// Selects a branching strategy at compile time
+	template<bool value> struct BoolTag {};
+
+	/**
+	 * An entry in the priority queue
+	 */
+	struct Entry {
+		Entry(double _priority, unsigned int _nodeIndex)
+			: priority(_priority), nodeIndex(_nodeIndex) {}
+
+		// std heaps keep the largest entry on top, so the entry with the
+		// smallest priority is the largest. Ties are broken by node index,
+		// so results do not depend on the heap's internal order.
+		bool operator< (const Entry& other) const {
+			return (priority > other.priority) ||
+				   ((priority == other.priority) && (nodeIndex > other.nodeIndex));
+		}
+
+		// The node's weight minus the expected weight at its depth
+		double priority;
+
+		// The index of the node in m_nodes
+		unsigned int nodeIndex;
+	};
+
+	/**
+	 * Branches a node, allocating its children from the arena.
+	 * @param pushChildren: true if the children should be put in the queue
+	 * @return the index of the best child
+	 */
+	unsigned int expand(unsigned int nodeIndex, bool pushChildren);
+
+	/**
+	 * Evaluates all children of 'parent' into 'children'. Uses the
+	 *     evaluator's branchAll() if it has one, and branch() for every child
+	 *     otherwise.
+	 */
+	void branchChildren(Node& parent,
+						BranchData& branchData,
+						Node* children,
+						BoolTag<true>);
+	void branchChildren(Node& parent,
+						BranchData& branchData,
+						Node* children,
+						BoolTag<false>);
+
+	/**
+	 * @return the depth of a node in the arena
+	 */
+	unsigned int depth(unsigned int nodeIndex) const;
+
+	/**
+	 * Writes the path from the root to a node into 'path'
+	 */
+	void backtrack(unsigned int nodeIndex,
+				   std::vector<unsigned short>& path) const;
+
+	// The number of nodes the search makes before continuing greedily
+	const unsigned int m_maxNumNodes;
+
+	// Multiplies expected weights, when computing priorities
+	const double m_bias;
+
+	// The maximum search depth
+	const unsigned int m_maxSearchDepth;
+
+	// The branch evaluator
+	BranchEvaluator m_branchEvaluator;
+
+	// The number of bits in branchFactor
+	const unsigned int m_logBranchFactor;
+
+	// The number of children of each node
+	const unsigned int m_branchFactor;
+
+	// The node arena. m_nodes[0] is the root, and the children of the g'th
+	// node to be branched are m_nodes[1 + g * branchFactor] onwards.
+	std::vector<Node> m_nodes;
+
+	// The number of nodes in use in m_nodes
+	unsigned int m_numNodes;
+
+	// The parent of each group of children, and the group's depth
+	std::vector<unsigned int> m_groupParents;
+	std::vector<unsigned int> m_groupDepths;
+
+	// The priority queue of nodes that were not branched
+	std::vector<Entry> m_queue;
+
+	// The branch data of every depth
+	std::vector<BranchData> m_branchData;
+
+	// The expected weight of the correct path at every depth
+	std::vector<double> m_expectedWeights;
+
+	// The expected weight of the next step, see setExpectedStepWeight()
+	double m_expectedStepWeight;
+
+	// The best node at the deepest depth
+	unsigned int m_best;
+
+	// True if the node budget ran out, and the search continues greedily
+	bool m_greedy;
+};
+
+
+// IMPLEMENTATION
+
+template<typename BranchEvaluator>
+inline StackSearch<BranchEvaluator>::StackSearch(
+		unsigned int maxNumNodes,
+		double bias,
+		unsigned int maxSearchDepth,
+		const BranchEvaluator& branchEvaluator,
+		unsigned int logBranchFactor)
+  : m_maxNumNodes(maxNumNodes),
+    m_bias(bias),
+    m_maxSearchDepth(maxSearchDepth),
+    m_branchEvaluator(branchEvaluator),
+    m_logBranchFactor(logBranchFactor),
+    m_branchFactor(1 << logBranchFactor),
+    m_numNodes(0),
+    m_expectedStepWeight(0),
+    m_best(0),
+    m_greedy(false)
+{
+	if(RenormalizesWeights<BranchEvaluator>::value) {
+		throw(std::runtime_error("StackSearch needs absolute weights, evaluator renormalizes weights"));
+	}
+
+	// The budget, plus a greedy branch at every depth. Groups of children
+	// need to fit whole.
+	unsigned int maxNumGroups = (maxNumNodes / m_branchFactor) + maxSearchDepth;
+
+	m_nodes.resize(1 + maxNumGroups * m_branchFactor);
+	for(unsigned int i = 0; i < m_nodes.size(); i++) {
+		m_branchEvaluator.initNode(m_nodes[i]);
+	}
+	m_groupParents.resize(maxNumGroups);
+	m_groupDepths.resize(maxNumGroups);
+
+	m_queue.reserve(m_nodes.size());
+	m_branchData.reserve(maxSearchDepth);
+	m_expectedWeights.reserve(maxSearchDepth + 1);
+}
+
+template<typename BranchEvaluator>
+inline BranchEvaluator& StackSearch<BranchEvaluator>::branchEvaluator() {
+	return m_branchEvaluator;
+}
+
+template<typename BranchEvaluator>
+inline void StackSearch<BranchEvaluator>::initialize()
+{
+	m_numNodes = 1;
+	m_best = 0;
+	m_greedy = false;
+
+	m_queue.clear();
+	m_queue.push_back(Entry(0, 0));
+
+	m_branchData.clear();
+	m_expectedWeights.assign(1, 0.0);
+	m_expectedStepWeight = 0;
+}
+
+template<typename BranchEvaluator>
+inline typename StackSearch<BranchEvaluator>::Node&
+StackSearch<BranchEvaluator>::getRoot()
+{
+	return m_nodes[0];
+}
+
+template<typename BranchEvaluator>
+inline void StackSearch<BranchEvaluator>::setExpectedStepWeight(double weight)
+{
+	m_expectedStepWeight = weight;
+}
+
+template<typename BranchEvaluator>
+inline void StackSearch<BranchEvaluator>::advance(BranchData& branchData)
+{
+	if(m_branchData.size() >= m_maxSearchDepth) {
+		throw(std::runtime_error("StackSearch advanced beyond its maximum depth"));
+	}
+
+	m_branchData.push_back(branchData);
+	m_expectedWeights.push_back(m_expectedWeights.back() + m_expectedStepWeight);
+	m_expectedStepWeight = 0;
+
+	const unsigned int newDepth = m_branchData.size();
+
+	while(!m_greedy) {
+		const Entry top = m_queue.front();
+		if(depth(top.nodeIndex) == newDepth) {
+			// The most promising node is at the new depth. It stays in the
+			// queue, to be branched in the next advance()
+			m_best = top.nodeIndex;
+			return;
+		}
+
+		if(m_numNodes + m_branchFactor > 1 + m_maxNumNodes) {
+			// Out of budget; m_best is still the best node of the previous
+			// depth
+			m_greedy = true;
+			break;
+		}
+
+		std::pop_heap(m_queue.begin(), m_queue.end());
+		m_queue.pop_back();
+		expand(top.nodeIndex, true);
+	}
+
+	m_best = expand(m_best, false);
+}
+
+template<typename BranchEvaluator>
+inline unsigned int StackSearch<BranchEvaluator>::expand(unsigned int nodeIndex,
+														 bool pushChildren)
+{
+	const unsigned int group = (m_numNodes - 1) >> m_logBranchFactor;
+	const unsigned int childDepth = depth(nodeIndex) + 1;
+	const unsigned int first = m_numNodes;
+
+	m_groupParents[group] = nodeIndex;
+	m_groupDepths[group] = childDepth;
+	m_numNodes += m_branchFactor;
+
+	Node* children = &m_nodes[first];
+	branchChildren(m_nodes[nodeIndex],
+				   m_branchData[childDepth - 1],
+				   children,
+				   BoolTag<HasBranchAll<BranchEvaluator>::value>());
+
+	const double expected = m_bias * m_expectedWeights[childDepth];
+	unsigned int best = first;
+	for(unsigned int edge = 0; edge < m_branchFactor; edge++) {
+		if(children[edge].getWeight() < m_nodes[best].getWeight()) {
+			best = first + edge;
+		}
+
+		if(pushChildren) {
+			m_queue.push_back(Entry(double(children[edge].getWeight()) - expected,
+									first + edge));
+			std::push_heap(m_queue.begin(), m_queue.end());
+		}
+	}
+
+	return best;
+}
+
+template<typename BranchEvaluator>
+inline void StackSearch<BranchEvaluator>::branchChildren(
+		Node& parent,
+		BranchData& branchData,
+		Node* children,
+		BoolTag<true>)
+{
+	m_branchEvaluator.branchAll(parent, branchData, children);
+}
+
+template<typename BranchEvaluator>
+inline void StackSearch<BranchEvaluator>::branchChildren(
+		Node& parent,
+		BranchData& branchData,
+		Node* children,
+		BoolTag<false>)
+{
+	for(unsigned int edge = 0; edge < m_branchFactor; edge++) {
+		m_branchEvaluator.branch(parent, edge, branchData, children[edge]);
+	}
+}
+
+template<typename BranchEvaluator>
+inline unsigned int StackSearch<BranchEvaluator>::depth(
+		unsigned int nodeIndex) const
+{
+	if(nodeIndex == 0) {
+		return 0;
+	}
+	return m_groupDepths[(nodeIndex - 1) >> m_logBranchFactor];
+}
+
+template<typename BranchEvaluator>
+inline void StackSearch<BranchEvaluator>::backtrack(
+		unsigned int nodeIndex,
+		std::vector<unsigned short>& path) const
+{
+	path.resize(depth(nodeIndex));
+
+	while(nodeIndex != 0) {
+		unsigned int group = (nodeIndex - 1) >> m_logBranchFactor;
+		path[m_groupDepths[group] - 1] = (nodeIndex - 1) & (m_branchFactor - 1);
+		nodeIndex = m_groupParents[group];
+	}
+}
+
+template<typename BranchEvaluator>
+inline typename StackSearch<BranchEvaluator>::Node&
+StackSearch<BranchEvaluator>::getBestPath(std::vector<unsigned short>& bestPath)
+{
+	backtrack(m_best, bestPath);
+	return m_nodes[m_best];
+}
+
+template<typename BranchEvaluator>
+inline void StackSearch<BranchEvaluator>::getIntermediate(
+		std::vector<SearchIntermediateResult<Node> >& interm)
+{
+	const unsigned int deepest = depth(m_best);
+
+	interm.resize(1);
+	interm[0].node = m_nodes[m_best];
+	backtrack(m_best, interm[0].path);
+
+	for(unsigned int nodeIndex = 1; nodeIndex < m_numNodes; nodeIndex++) {
+		if((nodeIndex == m_best) || (depth(nodeIndex) != deepest)) {
+			continue;
+		}
+
+		interm.resize(interm.size() + 1);
+		interm.back().node = m_nodes[nodeIndex];
+		backtrack(nodeIndex, interm.back().path);
+	}
+}
+
+template<typename BranchEvaluator>
+inline void StackSearch<BranchEvaluator>::setCheckpointing(bool enable)
+{}
+
+template<typename BranchEvaluator>
+inline unsigned int StackSearch<BranchEvaluator>::rewind(unsigned int depth)
+{
+	unsigned int currentDepth = m_branchData.size();
+	return (depth >= currentDepth) ? currentDepth : 0;
+}
+
+template<typename BranchEvaluator>
+inline void StackSearch<BranchEvaluator>::setTracebackWindow(unsigned int numLayers)
+{}
+
+template<typename BranchEvaluator>
+inline unsigned int StackSearch<BranchEvaluator>::numNodes() const
+{
+	return m_numNodes;
+}
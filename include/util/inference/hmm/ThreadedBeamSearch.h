@@ -0,0 +1,613 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <vector>
+
+#include "Backtracker.h"
+#include "BestK.h"
+#include "DualPool.h"
+#include "BeamSearch.h" // for SearchIntermediateResult, HasBranchAll
+#include "WeightTraits.h"
+#include "../../WorkerPool.h"
+
+/**
+ * \ingroup hmm
+ * \brief Beam search that branches the beam on several threads.
+ *
+ * The search explores the same tree as BeamSearch with a BestK pruner, and
+ *    returns exactly the same results, but splits the work of every advance()
+ *    between a fixed pool of workers.
+ *
+ * Inner workings:
+ *   - The beam is split into one contiguous slice per worker. Children of the
+ *     i'th node in the beam are stored in m_nodePool at indices
+ *     [i * branchFactor, (i+1) * branchFactor), just as in BeamSearch, so each
+ *     worker writes only to its own slice of the node pool.
+ *   - Every worker has a private BestK and a private copy of the branch
+ *     evaluator, so workers share no mutable state while branching.
+ *   - After all workers are done, their sorted BestK outputs are merged into
+ *     the new beam.
+ *   - Suggestions are ordered by weight, then by pool index. Every worker
+ *     pushes children in increasing pool index, so each worker keeps exactly
+ *     the smallest children of its slice in that order, and the merge yields
+ *     the same beam as a single BestK would.
+ */
+template<typename BranchEvaluator>
+class ThreadedBeamSearch : private IWorkerTask {
+private:
+	// forward declaration
+	struct Suggestion;
+public:
+	typedef BranchEvaluator Evaluator;
+	typedef typename BranchEvaluator::Node Node;
+	typedef typename BranchEvaluator::Weight Weight;
+	typedef typename BranchEvaluator::BranchData BranchData;
+
+	/**
+	 * C'tor
+	 * @param beamWidth: the number of nodes kept in the beam
+	 * @param numThreads: the number of workers branching the beam, including
+	 * 		the thread calling advance()
+	 * @param maxSearchDepth: the maximum depth of the search tree that is
+	 * 		explored. This value is used in allocating backtracking structures.
+	 * @param branchEvaluator: The class used to get a child node, from parent.
+	 * 		Every worker gets its own copy.
+	 * @param logBranchFactor: The log of number of children each node can
+	 * 		have (this is used in backtracking and in branch stages)
+	 */
+	ThreadedBeamSearch(unsigned int beamWidth,
+					   unsigned int numThreads,
+					   unsigned int maxSearchDepth,
+					   const BranchEvaluator &branchEvaluator,
+					   unsigned int logBranchFactor);
+
+	/**
+	 * Copy c'tor
+	 *
+	 * @important The copy constructor only copies the search structure, not
+	 *     search state, and starts its own worker threads. Call initialize
+	 *     after copying.
+	 */
+	ThreadedBeamSearch(const ThreadedBeamSearch& other);
+
+	/**
+	 * Returns a reference to the branch evaluator of the first worker.
+	 *
+	 * @note changes to the returned evaluator are not seen by other workers
+	 */
+	BranchEvaluator& branchEvaluator();
+
+	/**
+	 * Initializes a new search.
+	 */
+	void initialize();
+
+	/**
+	 * @return A reference to the root node. The root node should be initialized
+	 *     by the caller.
+	 * @note the return value of this method is only valid after
+	 *     initialize() and before any calls to advance()
+	 */
+	Node& getRoot();
+
+	/**
+	 * Branches all the nodes in the beam, to get their children, and selects
+	 *     the best children as new beam. @see BeamSearch::advance
+	 */
+	void advance(BranchData& branchData);
+
+	/**
+	 * Gets the best path explored by the search so far.
+	 *     @see BeamSearch::getBestPath
+	 */
+	Node& getBestPath(std::vector<unsigned short>& bestPath);
+
+	/**
+	 * Returns the intermediate state of the search.
+	 *     @see BeamSearch::getIntermediate
+	 */
+	void getIntermediate(
+			std::vector<SearchIntermediateResult<Node> >& interm);
+
+	/**
+	 * Enables or disables checkpointing, @see BeamSearch::setCheckpointing
+	 */
+	void setCheckpointing(bool enable);
+
+	/**
+	 * Rewinds the search, @see BeamSearch::rewind
+	 */
+	unsigned int rewind(unsigned int depth);
+
+	/**
+	 * Limits backtracking memory, @see BeamSearch::setTracebackWindow
+	 */
+	void setTracebackWindow(unsigned int numLayers);
+
+private:
+	/**
+	 * A structure that holds information about a node in the search.
+	 */
+	struct Suggestion {
+		typedef typename BranchEvaluator::Weight Weight;
+
+		Suggestion(Weight _weight, unsigned int _poolIndex)
+			: weight(_weight), poolIndex(_poolIndex) {}
+
+		// Compares two suggestions based on weight, then pool index
+		bool operator< (const Suggestion& other) const;
+
+		// The weight of the node
+		Weight weight;
+
+		// The index into the node pool of the node.
+		unsigned int poolIndex;
+	};
+
+	/**
+	 * State private to every worker
+	 */
+	struct Worker {
+		Worker(unsigned int beamWidth, const BranchEvaluator& evaluator)
+			: nextBeam(beamWidth), branchEvaluator(evaluator) {}
+
+		// Best children found by the worker
+		BestK<Suggestion> nextBeam;
+
+		// The worker's evaluator, with its own scratch buffers
+		BranchEvaluator branchEvaluator;
+
+		// The worker's best children, sorted
+		std::vector<Suggestion> sorted;
+
+		// Position in 'sorted' during the merge
+		unsigned int mergePosition;
+	};
+
+	// Selects a branching strategy at compile time
+	template<bool value> struct BoolTag {};
+
+	/**
+	 * Branches the worker's slice of the beam. Runs on the worker's thread.
+	 */
+	virtual void work(unsigned int workerIndex);
+
+	/**
+	 * Evaluates all children of 'parent' into the child pool, starting at
+	 *     index 'firstPoolIndex', @see BeamSearch::branchChildren
+	 */
+	void branchChildren(BranchEvaluator& evaluator,
+						Node& parent,
+						unsigned int firstPoolIndex,
+						BoolTag<true>);
+	void branchChildren(BranchEvaluator& evaluator,
+						Node& parent,
+						unsigned int firstPoolIndex,
+						BoolTag<false>);
+
+	/**
+	 * Merges the workers' sorted children into m_beam
+	 */
+	void mergeWorkers();
+
+	/**
+	 * Subtracts the best weight from all beam nodes, if the evaluator
+	 *     renormalizes weights, @see BeamSearch::renormalize
+	 */
+	void renormalize(BoolTag<true>);
+	void renormalize(BoolTag<false>) {}
+
+	/**
+	 * Initializes the node pool and the workers
+	 */
+	void initPools();
+
+	/**
+	 * Saves the current beam as the checkpoint for the current depth
+	 */
+	void saveCheckpoint();
+
+	// The number of nodes kept in the beam
+	const unsigned int m_beamWidth;
+
+	// The maximum search depth
+	const unsigned int m_maxSearchDepth;
+
+	// The branch evaluator, from which workers' evaluators are copied
+	const BranchEvaluator m_branchEvaluator;
+
+	// The number of bits in branchFactor
+	const unsigned int m_logBranchFactor;
+
+	// The branch factor
+	const unsigned int m_branchFactor;
+
+	// Backtracker
+	Backtracker<unsigned int> m_backtracker;
+
+	// All nodes used in the search, including the beam, and the children.
+	DualPool<Node> m_nodePool;
+
+	// The indices of elements in the beam
+	std::vector<Suggestion> m_beam;
+
+	// Per-worker state
+	std::vector<Worker> m_workers;
+
+	// The branch data of the advance() in progress
+	BranchData* m_branchData;
+
+	// The threads running the workers
+	WorkerPool m_workerPool;
+
+	// True if the beam should be saved after every advance()
+	bool m_checkpointing;
+
+	// The number of layers the backtracker keeps, 0 for all
+	unsigned int m_tracebackWindow;
+
+	// Saved beams, @see BeamSearch
+	std::vector<Suggestion> m_checkpointBeams;
+	std::vector<Node> m_checkpointNodes;
+	std::vector<unsigned int> m_checkpointSizes;
+};
+
+
+// IMPLEMENTATION
+
+#include <assert.h>
+#include <stdexcept>
+
+template<typename BranchEvaluator>
+inline ThreadedBeamSearch<BranchEvaluator>::ThreadedBeamSearch(
+		unsigned int beamWidth,
+		unsigned int numThreads,
+		unsigned int maxSearchDepth,
+		const BranchEvaluator & branchEvaluator,
+		unsigned int logBranchFactor)
+  : m_beamWidth(beamWidth),
+    m_maxSearchDepth(maxSearchDepth),
+    m_branchEvaluator(branchEvaluator),
+    m_logBranchFactor(logBranchFactor),
+    m_branchFactor(1 << m_logBranchFactor),
+    m_backtracker(m_beamWidth, m_maxSearchDepth, m_logBranchFactor),
+    m_nodePool(m_beamWidth * m_branchFactor),
+    m_beam(),
+    m_workers(numThreads, Worker(m_beamWidth, m_branchEvaluator)),
+    m_branchData(NULL),
+    m_workerPool(numThreads),
+    m_checkpointing(false),
+    m_tracebackWindow(0)
+{
+	initPools();
+}
+
+template<typename BranchEvaluator>
+inline ThreadedBeamSearch<BranchEvaluator>::ThreadedBeamSearch(
+		const ThreadedBeamSearch& other)
+  : m_beamWidth(other.m_beamWidth),
+    m_maxSearchDepth(other.m_maxSearchDepth),
+    m_branchEvaluator(other.m_branchEvaluator),
+    m_logBranchFactor(other.m_logBranchFactor),
+    m_branchFactor(1 << m_logBranchFactor),
+    m_backtracker(m_beamWidth, m_maxSearchDepth, m_logBranchFactor),
+    m_nodePool(m_beamWidth * m_branchFactor),
+    m_beam(),
+    m_workers(other.m_workers.size(), Worker(m_beamWidth, m_branchEvaluator)),
+    m_branchData(NULL),
+    m_workerPool(other.m_workers.size()),
+    m_checkpointing(false),
+    m_tracebackWindow(0)
+{
+	initPools();
+
+	setCheckpointing(other.m_checkpointing);
+	setTracebackWindow(other.m_tracebackWindow);
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::initPools()
+{
+	m_beam.reserve(m_beamWidth);
+
+	// Initialize the node pool
+	for(unsigned int i = 0; i < m_nodePool.size(); i++) {
+		m_workers[0].branchEvaluator.initNode(m_nodePool.primary(i));
+		m_workers[0].branchEvaluator.initNode(m_nodePool.secondary(i));
+	}
+
+	for(unsigned int i = 0; i < m_workers.size(); i++) {
+		m_workers[i].sorted.reserve(m_beamWidth);
+	}
+}
+
+template<typename BranchEvaluator>
+inline BranchEvaluator & ThreadedBeamSearch<BranchEvaluator>::branchEvaluator() {
+	return m_workers[0].branchEvaluator;
+}
+
+template<typename BranchEvaluator>
+inline void	ThreadedBeamSearch<BranchEvaluator>::initialize()
+{
+	// Reset backtracking
+	m_backtracker.reset();
+
+	m_beam.clear();
+	m_beam.push_back(Suggestion(0,0));
+}
+
+template<typename BranchEvaluator>
+inline typename ThreadedBeamSearch<BranchEvaluator>::Node &
+ThreadedBeamSearch<BranchEvaluator>::getRoot()
+{
+	return m_nodePool.primary(0);
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::advance(BranchData& branchData)
+{
+	// Branch the beam on all workers
+	m_branchData = &branchData;
+	m_workerPool.run(*this);
+	m_branchData = NULL;
+
+	// Collect the best children from all workers
+	mergeWorkers();
+
+	// The nodes for the current beam now reside where 'next layer' nodes
+	// used to reside
+	m_nodePool.flip();
+
+	// Sanity check: there should be at most m_beamWidth elements in beam.
+	assert(m_beam.size() <= m_beamWidth);
+
+	// Keep weights relative to the best node, if the evaluator needs it
+	renormalize(BoolTag<RenormalizesWeights<BranchEvaluator>::value>());
+
+	// save backtracking information
+	typename std::vector<Suggestion>::iterator beamNode;
+	for(beamNode = m_beam.begin(); beamNode != m_beam.end(); beamNode++) {
+		unsigned int poolIndex = beamNode->poolIndex;
+		m_backtracker.saveNode(poolIndex >> m_logBranchFactor,
+							   poolIndex & (m_branchFactor - 1));
+	}
+
+	// Close this layer in the backtracker
+	m_backtracker.nextLayer();
+
+	if(m_checkpointing) {
+		saveCheckpoint();
+	}
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::work(unsigned int workerIndex)
+{
+	Worker& worker = m_workers[workerIndex];
+
+	// Sanity check: nextBeam is always empty outside advance()
+	assert(worker.nextBeam.size() == 0);
+
+	// This worker's slice of the beam
+	unsigned int numWorkers = m_workers.size();
+	unsigned int beginIndex = (m_beam.size() * workerIndex) / numWorkers;
+	unsigned int endIndex = (m_beam.size() * (workerIndex + 1)) / numWorkers;
+
+	for(unsigned int beamIndex = beginIndex; beamIndex < endIndex; beamIndex++) {
+		const Suggestion& parent = m_beam[beamIndex];
+
+		// only bother to enumerate if there is a chance to be included in next round
+		if(!worker.nextBeam.checkPush(parent.weight)) {
+			continue;
+		}
+
+		unsigned int poolIndex = beamIndex * m_branchFactor;
+
+		// Evaluate all possible bit combinations
+		branchChildren(worker.branchEvaluator,
+					   m_nodePool.primary(parent.poolIndex),
+					   poolIndex,
+					   BoolTag<HasBranchAll<BranchEvaluator>::value>());
+
+		// update the worker's best children with the new values.
+		for (unsigned int msgBits = 0; msgBits < m_branchFactor; msgBits++) {
+			worker.nextBeam.push(Suggestion(
+								m_nodePool.secondary(poolIndex).getWeight(),
+								poolIndex));
+			poolIndex++;
+		}
+	}
+
+	// Sort while still running in parallel
+	worker.nextBeam.putSorted(worker.sorted);
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::branchChildren(
+		BranchEvaluator& evaluator,
+		Node& parent,
+		unsigned int firstPoolIndex,
+		BoolTag<true>)
+{
+	// Children of a node are adjacent in the pool
+	evaluator.branchAll(parent,
+						*m_branchData,
+						m_nodePool.secondaryPtr(firstPoolIndex));
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::branchChildren(
+		BranchEvaluator& evaluator,
+		Node& parent,
+		unsigned int firstPoolIndex,
+		BoolTag<false>)
+{
+	// enumerate over all possible bit combinations
+	for (unsigned int msgBits = 0; msgBits < m_branchFactor; msgBits++) {
+		evaluator.branch(parent,
+						 msgBits,
+						 *m_branchData,
+						 m_nodePool.secondary(firstPoolIndex + msgBits));
+	}
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::mergeWorkers()
+{
+	m_beam.clear();
+
+	for(unsigned int i = 0; i < m_workers.size(); i++) {
+		m_workers[i].mergePosition = 0;
+	}
+
+	// Repeatedly take the smallest head among the workers' sorted lists
+	while(m_beam.size() < m_beamWidth) {
+		Worker* best = NULL;
+		for(unsigned int i = 0; i < m_workers.size(); i++) {
+			Worker& worker = m_workers[i];
+			if(worker.mergePosition == worker.sorted.size()) {
+				continue;
+			}
+			if((best == NULL) ||
+			   (worker.sorted[worker.mergePosition] < best->sorted[best->mergePosition]))
+			{
+				best = &worker;
+			}
+		}
+
+		if(best == NULL) {
+			// All lists exhausted
+			break;
+		}
+
+		m_beam.push_back(best->sorted[best->mergePosition]);
+		best->mergePosition++;
+	}
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::renormalize(BoolTag<true>)
+{
+	if(m_beam.empty()) {
+		return;
+	}
+
+	// mergeWorkers() places the best node first
+	const Weight offset = m_beam[0].weight;
+
+	// The evaluator is only used between steps, when workers are idle
+	BranchEvaluator& evaluator = m_workers[0].branchEvaluator;
+
+	typename std::vector<Suggestion>::iterator beamIter;
+	for(beamIter = m_beam.begin(); beamIter != m_beam.end(); beamIter++) {
+		beamIter->weight -= offset;
+		evaluator.renormalize(m_nodePool.primary(beamIter->poolIndex), offset);
+	}
+}
+
+template<typename BranchEvaluator>
+inline typename ThreadedBeamSearch<BranchEvaluator>::Node &
+	ThreadedBeamSearch<BranchEvaluator>::getBestPath(
+									std::vector<unsigned short> & bestPath)
+{
+	m_backtracker.backtrack<unsigned short>(0, bestPath);
+	return m_nodePool.primary(m_beam[0].poolIndex);
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::getIntermediate(
+		std::vector<SearchIntermediateResult<Node> > & interm)
+{
+	interm.clear();
+	interm.resize(m_beam.size());
+
+	for(unsigned int i = 0; i < m_beam.size(); i++) {
+		interm[i].node = m_nodePool.primary(m_beam[i].poolIndex);
+		m_backtracker.backtrack(i,interm[i].path);
+	}
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::setCheckpointing(bool enable)
+{
+	m_checkpointing = enable;
+
+	if(m_checkpointing && m_checkpointSizes.empty()) {
+		// Allocate storage for a full beam in every depth
+		unsigned int numSaved = m_maxSearchDepth * m_beamWidth;
+		m_checkpointBeams.resize(numSaved, Suggestion(0,0));
+		m_checkpointNodes.resize(numSaved);
+		m_checkpointSizes.resize(m_maxSearchDepth, 0);
+
+		for(unsigned int i = 0; i < numSaved; i++) {
+			m_workers[0].branchEvaluator.initNode(m_checkpointNodes[i]);
+		}
+	}
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::saveCheckpoint()
+{
+	// Checkpoint of depth d is saved in slot d-1
+	unsigned int slot = m_backtracker.numLayers() - 1;
+	unsigned int offset = slot * m_beamWidth;
+
+	for(unsigned int i = 0; i < m_beam.size(); i++) {
+		m_checkpointBeams[offset + i] = m_beam[i];
+		m_checkpointNodes[offset + i] = m_nodePool.primary(m_beam[i].poolIndex);
+	}
+	m_checkpointSizes[slot] = m_beam.size();
+}
+
+template<typename BranchEvaluator>
+inline unsigned int ThreadedBeamSearch<BranchEvaluator>::rewind(unsigned int depth)
+{
+	unsigned int currentDepth = m_backtracker.numLayers();
+
+	if(depth >= currentDepth) {
+		// Already there, nothing to restore
+		return currentDepth;
+	}
+
+	if((!m_checkpointing) || (depth == 0)) {
+		// The root is initialized by the caller, so it is not checkpointed
+		return 0;
+	}
+
+	unsigned int slot = depth - 1;
+	unsigned int offset = slot * m_beamWidth;
+	unsigned int beamSize = m_checkpointSizes[slot];
+
+	// Restore the beam and its nodes into the primary pool
+	m_beam.assign(m_checkpointBeams.begin() + offset,
+				  m_checkpointBeams.begin() + offset + beamSize);
+	for(unsigned int i = 0; i < beamSize; i++) {
+		m_nodePool.primary(m_beam[i].poolIndex) = m_checkpointNodes[offset + i];
+	}
+
+	// Forget backtracking information of the discarded layers
+	m_backtracker.rewind(depth);
+
+	return depth;
+}
+
+template<typename BranchEvaluator>
+inline void ThreadedBeamSearch<BranchEvaluator>::setTracebackWindow(unsigned int numLayers)
+{
+	m_tracebackWindow = numLayers;
+	m_backtracker.setWindow(numLayers);
+}
+
+// THREADEDBEAMSEARCH::SUGGESTION
+template<typename BranchEvaluator>
+inline bool ThreadedBeamSearch<BranchEvaluator>::Suggestion::operator <(
+		const Suggestion & other) const
+{
+	// Ties are broken by pool index, so the order does not depend on how the
+	// beam was split between workers
+	return (weight < other.weight) ||
+		   ((weight == other.weight) && (poolIndex < other.poolIndex));
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * \ingroup hmm
+ * \brief Arithmetic on path weights.
+ *
+ * Narrow unsigned weights saturate at their maximum instead of wrapping
+ *    around, so a path whose weight overflows stays worse than all others.
+ */
+template<typename Weight>
+struct WeightTraits {
+	static Weight add(Weight a, Weight b) { return a + b; }
+};
+
+template<>
+struct WeightTraits<uint16_t> {
+	static uint16_t add(uint16_t a, uint16_t b) {
+		uint16_t sum = a + b;
+		// all ones if the sum wrapped around
+		return sum | -(uint16_t)(sum < a);
+	}
+};
+
+template<>
+struct WeightTraits<uint32_t> {
+	static uint32_t add(uint32_t a, uint32_t b) {
+		uint32_t sum = a + b;
+		return sum | -(uint32_t)(sum < a);
+	}
+};
+
+template<typename T, bool HAS_FLAG>
+struct RenormalizeWeightsFlag {
+	enum { value = 0 };
+};
+
+template<typename T>
+struct RenormalizeWeightsFlag<T, true> {
+	enum { value = (T::RENORMALIZE_WEIGHTS != 0) };
+};
+
+/**
+ * \ingroup hmm
+ * \brief Detects whether weights should be renormalized after every search
+ *     step, i.e. whether T has a non-zero enum RENORMALIZE_WEIGHTS.
+ *
+ * Branch evaluators with a non-zero RENORMALIZE_WEIGHTS also have a method
+ *     void renormalize(Node& node, Weight offset)
+ *     that subtracts 'offset' from all weights in the node. Searches call it
+ *     on every node in the beam after each step, with the best node's weight,
+ *     so weights stay small enough for narrow types. Distances use the same
+ *     enum to tell evaluators that their weights need renormalization.
+ */
+template<typename T>
+class RenormalizesWeights {
+private:
+	typedef char Yes;
+	typedef struct { char dummy[2]; } No;
+
+	template<int> struct Marker {};
+
+	template<typename U>
+	static Yes test(Marker<U::RENORMALIZE_WEIGHTS>*);
+
+	template<typename U>
+	static No test(...);
+
+public:
+	enum { value = RenormalizeWeightsFlag<T,
+						(sizeof(test<T>(0)) == sizeof(Yes))>::value };
+};
+
+template<typename T, bool HAS_FLAG>
+struct ExpectedWeightsFlag {
+	enum { value = 0 };
+};
+
+template<typename T>
+struct ExpectedWeightsFlag<T, true> {
+	enum { value = (T::USES_EXPECTED_WEIGHTS != 0) };
+};
+
+/**
+ * \ingroup hmm
+ * \brief Detects whether a search compares paths of different lengths using
+ *     the weight the correct path is expected to have, i.e. whether T has a
+ *     non-zero enum USES_EXPECTED_WEIGHTS.
+ *
+ * Such searches have a method
+ *     void setExpectedStepWeight(double weight)
+ *     that should be called before every advance(), with the weight the
+ *     correct path is expected to gain in that step (see StackSearch).
+ */
+template<typename T>
+class UsesExpectedWeights {
+private:
+	typedef char Yes;
+	typedef struct { char dummy[2]; } No;
+
+	template<int> struct Marker {};
+
+	template<typename U>
+	static Yes test(Marker<U::USES_EXPECTED_WEIGHTS>*);
+
+	template<typename U>
+	static No test(...);
+
+public:
+	enum { value = ExpectedWeightsFlag<T,
+						(sizeof(test<T>(0)) == sizeof(Yes))>::value };
+};
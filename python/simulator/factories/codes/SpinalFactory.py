@@ -26,7 +26,8 @@ class SpinalFactory(object):
     def make_decoder(self, codeSpec, packetLength, decodeSpec, mapSpec, channelSpec):
         if codeSpec['type'] != 'spinal':
             return None
-        if decodeSpec['type'] not in ['regular', 'lookahead', 'parallel']:
+        if decodeSpec['type'] not in ['regular', 'lookahead', 'parallel', 'threaded',
+                                      'stack']:
             return None
         
         spineLength = self._get_num_blocks(codeSpec['k'], packetLength)
@@ -81,6 +82,28 @@ class SpinalFactory(object):
             return None
 
 
+    def _choose_hash(self, codeFactory, codeSpec):
+        """
+        Returns the encoder factory for the hash in codeSpec. If codeSpec has
+        'packedSymbolBits', symbols are bit-packed out of the hash state
+        (salsa and lookup3 only).
+        """
+        packedSymbolBits = codeSpec.get('packedSymbolBits', None)
+        if codeSpec['hash'] == 'salsa':
+            if packedSymbolBits is not None:
+                return codeFactory.packedSalsa(packedSymbolBits)
+            return codeFactory.salsa()
+        elif codeSpec['hash'] == 'lookup3':
+            if packedSymbolBits is not None:
+                return codeFactory.packedLookup3(packedSymbolBits)
+            return codeFactory.lookup3()
+        elif codeSpec['hash'] == 'one-at-a-time':
+            if packedSymbolBits is not None:
+                raise RuntimeError, "Packed symbols are not supported with one-at-a-time"
+            return codeFactory.oneAtATime()
+        else:
+            raise RuntimeError,"Unknown hash type %s" % codeSpec['hash']
+
     def _make_unpunctured_encoder(self, codeSpec, spineLength):
         """
         Makes an un-punctured spinal encoder.
@@ -89,14 +112,7 @@ class SpinalFactory(object):
         codeFactory = wireless.codes.spinal.CodeFactory(codeSpec['k'],
                                          spineLength)
         # Choose hash
-        if codeSpec['hash'] == 'salsa':
-            codeFactory = codeFactory.salsa()
-        elif codeSpec['hash'] == 'lookup3':
-            codeFactory = codeFactory.lookup3()
-        elif codeSpec['hash'] == 'one-at-a-time':
-            codeFactory = codeFactory.oneAtATime()
-        else:
-            raise RuntimeError,"Unknown hash type %s" % codeSpec['hash']
+        codeFactory = self._choose_hash(codeFactory, codeSpec)
         # Make unpunctured encoder
         unpuncturedEncoder = codeFactory.encoder()
         
@@ -112,20 +128,21 @@ class SpinalFactory(object):
         codeFactory = wireless.codes.spinal.CodeFactory(codeSpec['k'],
                                          spineLength)
         # Choose hash
-        if codeSpec['hash'] == 'salsa':
-            codeFactory = codeFactory.salsa()
-        elif codeSpec['hash'] == 'lookup3':
-            codeFactory = codeFactory.lookup3()
-        elif codeSpec['hash'] == 'one-at-a-time':
-            codeFactory = codeFactory.oneAtATime()
-        else:
-            raise RuntimeError,"Unknown hash type %s" % codeSpec['hash']
+        codeFactory = self._choose_hash(codeFactory, codeSpec)
+            
+        # Choose the type of path weights
+        metrics = {'default': wireless.codes.spinal.METRIC_DEFAULT,
+                   'uint32': wireless.codes.spinal.METRIC_UINT32,
+                   'uint16': wireless.codes.spinal.METRIC_UINT16,
+                   'float': wireless.codes.spinal.METRIC_FLOAT}
+        metric = metrics[decodeSpec.get('metric', 'default')]
             
         # Choose channel transformation
         if channelSpec['type'] in ['AWGN', 'AWGN-1D', 'BSC','transparent-coherence-symbol']:
             if mapSpec['type'] == 'linear':
                 codeFactory = codeFactory.linear(mapSpec['bitsPerSymbol'],
-                                                 mapSpec['precisionBits'])
+                                                 mapSpec['precisionBits'],
+                                                 metric)
                 valueType = wireless.Symbol
             elif mapSpec['type'] == 'trunc-norm-v2':
                 codeFactory = codeFactory.gaussian(mapSpec['bitsPerSymbol'],
@@ -137,7 +154,8 @@ class SpinalFactory(object):
             
         elif channelSpec['type'] in ['AWGN-soft']:
             if mapSpec['type'] == 'soft':
-                codeFactory = codeFactory.soft(mapSpec['bitsPerSymbol'])
+                codeFactory = codeFactory.soft(mapSpec['bitsPerSymbol'],
+                                               metric)
                 valueType = wireless.SoftSymbol
             else:
                 raise RuntimeError, 'unknown mapper'
@@ -147,10 +165,16 @@ class SpinalFactory(object):
         else:
             raise RuntimeError, 'unknown channel'
         
+        # Beam decoders can keep node fields in separate arrays
+        if decodeSpec.get('soa', False):
+            beamDecoder = codeFactory.soaBeamDecoder
+        else:
+            beamDecoder = codeFactory.beamDecoder
+        
         # Choose search algorithm
         if decodeSpec['type'] == 'regular':
             # beam search
-            unpuncturedDecoder = codeFactory.beamDecoder(
+            unpuncturedDecoder = beamDecoder(
                                                 1,
                                                 decodeSpec['beamWidth'],
                                                 decodeSpec['maxPasses'],
@@ -164,14 +188,45 @@ class SpinalFactory(object):
                                                 decodeSpec['maxPasses'])
         elif decodeSpec['type'] in ['parallel']:
             # beam search
-            unpuncturedDecoder = codeFactory.beamDecoder(
+            unpuncturedDecoder = beamDecoder(
                                                 decodeSpec['alpha'],
                                                 decodeSpec['beta'],
                                                 decodeSpec['maxPasses'],
                                                 decodeSpec['maxPasses'])
+        elif decodeSpec['type'] == 'threaded':
+            # beam search, branching on several threads
+            unpuncturedDecoder = codeFactory.threadedBeamDecoder(
+                                                decodeSpec['beamWidth'],
+                                                decodeSpec['numThreads'],
+                                                decodeSpec['maxPasses'],
+                                                decodeSpec['maxPasses'])
+        elif decodeSpec['type'] == 'stack':
+            # best-first sequential search, with a budget of nodes
+            unpuncturedDecoder = codeFactory.stackDecoder(
+                                                decodeSpec['maxNumNodes'],
+                                                decodeSpec.get('bias', 1.0),
+                                                decodeSpec['maxPasses'],
+                                                decodeSpec['maxPasses'])
         else:
             raise RuntimeError, 'unknown decoder type %s' % decodeSpec['type']
         
+        # Resume the search from cached beams when new symbols arrive
+        if 'incremental' in decodeSpec:
+            unpuncturedDecoder.setIncremental(decodeSpec['incremental'])
+
+        # Abandon decode attempts that are likely to fail, and ask for more
+        #     symbols early
+        if 'earlyTermination' in decodeSpec:
+            unpuncturedDecoder.setEarlyTermination(decodeSpec['earlyTermination'])
+
+        # Keep spine values from earlier decode attempts on the packet
+        if 'spineValueCache' in decodeSpec:
+            unpuncturedDecoder.setSpineValueCache(decodeSpec['spineValueCache'])
+
+        # Bound backtracking memory on long spines
+        if 'tracebackWindow' in decodeSpec:
+            unpuncturedDecoder.setTracebackWindow(decodeSpec['tracebackWindow'])
+        
         return unpuncturedDecoder, valueType
 
     @staticmethod
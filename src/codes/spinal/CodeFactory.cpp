@@ -4,6 +4,9 @@
  */
 #include "codes/spinal/CodeFactory.h"
 
+#include <algorithm>
+#include <stdexcept>
+
 #include "util/hashes/SalsaHash.h"
 #include "util/hashes/Lookup3Hash.h"
 #include "util/hashes/OneAtATimeHash.h"
@@ -20,14 +23,19 @@
 // Searches
 #include "util/inference/hmm/BestK.h"
 #include "util/inference/hmm/ParallelBestK.h"
+#include "util/inference/hmm/RadixSelectBestK.h"
 #include "util/inference/hmm/BeamSearch.h"
 #include "util/inference/hmm/LookaheadBeamSearch.h"
+#include "util/inference/hmm/ThreadedBeamSearch.h"
+#include "util/inference/hmm/StackSearch.h"
 
 // Branch evaluators
 #include "codes/spinal/SpinalBranchEvaluator.h"
+#include "codes/spinal/TableBranchEvaluator.h"
 
 #include "codes/spinal/HashEncoder.h"
 #include "codes/spinal/HashDecoder.h"
+#include "codes/spinal/StreamingHashDecoder.h"
 
 /**********************************
  * Class EncoderFactory definition
@@ -41,14 +49,25 @@ public:
 	virtual IMultiStreamEncoder::Ptr encoder();
 
 	virtual ISymbolSearchFactoryPtr linear(unsigned int premapperNumBits,
-										   unsigned int precisionBits);
-	virtual ISoftSearchFactoryPtr soft(unsigned int premapperNumBits);
+										   unsigned int precisionBits,
+										   SpinalMetric metric = METRIC_DEFAULT);
+	virtual ISoftSearchFactoryPtr soft(unsigned int premapperNumBits,
+									   SpinalMetric metric = METRIC_DEFAULT);
 	virtual ISymbolSearchFactoryPtr gaussian(unsigned int premapperNumBits,
 											 unsigned int precisionBits,
 											 float numStandardDevs);
 	virtual ISymbolSearchFactoryPtr bitwise(unsigned int numBits);
 	virtual IFadingSearchFactoryPtr coherence(unsigned int premapperNumBits);
 private:
+	/**
+	 * Makes a search factory that decodes the mapper's symbols using
+	 *     distance tables
+	 */
+	template<typename Mapper, typename Distance>
+	ISymbolSearchFactoryPtr tableSearch(const Mapper& mapper,
+										unsigned int premapperNumBits,
+										const Distance& distance);
+
 	unsigned int m_k;
 	unsigned int m_spineLength;
 };
@@ -61,6 +80,8 @@ class SearchFactory : public ISearchFactory<typename BranchEvaluator::ChannelSym
 public:
 	typedef typename BranchEvaluator::ChannelSymbol ChannelSymbol;
 	typedef std::tr1::shared_ptr<IHashDecoder<ChannelSymbol> > IHashDecoderPtr;
+	typedef std::tr1::shared_ptr<IStreamingHashDecoder<ChannelSymbol> >
+		IStreamingHashDecoderPtr;
 
 	SearchFactory(unsigned int k,
 				unsigned int spineLength,
@@ -76,7 +97,36 @@ public:
 			unsigned int lookaheadDepth,
 			unsigned int maxNumSymbolsPerValue,
 			unsigned int maxNumSymbolsLastValue);
+	virtual IHashDecoderPtr soaBeamDecoder(
+			unsigned int numLists,
+			unsigned int numBestPerList,
+			unsigned int maxNumSymbolsPerValue,
+			unsigned int maxNumSymbolsLastValue);
+	virtual IHashDecoderPtr threadedBeamDecoder(
+			unsigned int beamWidth,
+			unsigned int numThreads,
+			unsigned int maxNumSymbolsPerValue,
+			unsigned int maxNumSymbolsLastValue);
+	virtual IHashDecoderPtr stackDecoder(
+			unsigned int maxNumNodes,
+			double bias,
+			unsigned int maxNumSymbolsPerValue,
+			unsigned int maxNumSymbolsLastValue);
+	virtual IStreamingHashDecoderPtr streamingDecoder(
+			unsigned int beamWidth,
+			unsigned int commitDistance,
+			unsigned int maxNumSymbolsPerValue,
+			unsigned int maxNumSymbolsLastValue);
 private:
+	/**
+	 * Makes a single list beam decoder, where k and the beam width are fixed
+	 *     at compile time.
+	 */
+	template<unsigned int K, unsigned int BEAM_WIDTH>
+	IHashDecoderPtr fixedBeamDecoder(
+			unsigned int maxNumSymbolsPerValue,
+			unsigned int maxNumSymbolsLastValue);
+
 	const unsigned int m_k;
 	const unsigned int m_spineLength;
 	BranchEvaluator m_branchEvaluator;
@@ -112,10 +162,57 @@ IEncoderFactoryPtr CodeFactory::oneAtATime()
 			m_k, m_spineLength));
 }
 
+IEncoderFactoryPtr CodeFactory::packedSalsa(unsigned int symbolBits)
+{
+	switch(symbolBits) {
+	case 6:
+		return IEncoderFactoryPtr (
+			new EncoderFactory<UnlimitedHash<PackedSymbolFunction<SalsaHash, 6> > >(
+				m_k, m_spineLength));
+	case 8:
+		return IEncoderFactoryPtr (
+			new EncoderFactory<UnlimitedHash<PackedSymbolFunction<SalsaHash, 8> > >(
+				m_k, m_spineLength));
+	default:
+		throw(std::runtime_error("Packed symbols must have 6 or 8 bits"));
+	}
+}
+
+IEncoderFactoryPtr CodeFactory::packedLookup3(unsigned int symbolBits)
+{
+	switch(symbolBits) {
+	case 6:
+		return IEncoderFactoryPtr (
+			new EncoderFactory<UnlimitedHash<PackedSymbolFunction<Lookup3Hash, 6> > >(
+				m_k, m_spineLength));
+	case 8:
+		return IEncoderFactoryPtr (
+			new EncoderFactory<UnlimitedHash<PackedSymbolFunction<Lookup3Hash, 8> > >(
+				m_k, m_spineLength));
+	default:
+		throw(std::runtime_error("Packed symbols must have 6 or 8 bits"));
+	}
+}
+
 
 /************************************************
  * ENCODER FACTORY IMPLEMENTATION
  ************************************************/
+
+// Integer mappers with at most this many input bits are decoded using tables
+// of distances to all candidate symbols (see TableBranchEvaluator)
+static const unsigned int MAX_DISTANCE_TABLE_BITS = 10;
+
+/**
+ * @return the number of bits to drop from squared distances between symbols
+ *     of precisionBits bits, so they fit in distanceBits bits
+ */
+static unsigned int metricShift(unsigned int precisionBits,
+								unsigned int distanceBits)
+{
+	return std::max(int(2 * precisionBits) - int(distanceBits), 0);
+}
+
 template<typename SpineValueType>
 inline EncoderFactory<SpineValueType>::EncoderFactory(
 		unsigned int k,
@@ -138,24 +235,69 @@ template<typename SpineValueType>
 inline ISymbolSearchFactoryPtr
 EncoderFactory<SpineValueType>::linear(
 		unsigned int premapperNumBits,
-		unsigned int precisionBits)
+		unsigned int precisionBits,
+		SpinalMetric metric)
 {
+	LinearMapper mapper(premapperNumBits, precisionBits);
+
+	if(metric != METRIC_DEFAULT) {
+		if(premapperNumBits > MAX_DISTANCE_TABLE_BITS) {
+			throw(std::runtime_error("Narrow metrics need distance tables, premapperNumBits is too big"));
+		}
+
+		switch(metric) {
+		case METRIC_UINT32:
+			return tableSearch(mapper,
+							   premapperNumBits,
+							   SaturatingEuclidianDistance<uint32_t>(
+									   metricShift(precisionBits, 24)));
+		case METRIC_UINT16:
+			return tableSearch(mapper,
+							   premapperNumBits,
+							   SaturatingEuclidianDistance<uint16_t>(
+									   metricShift(precisionBits, 16)));
+		case METRIC_FLOAT:
+			return tableSearch(mapper,
+							   premapperNumBits,
+							   FloatEuclidianDistance<Symbol>());
+		default:
+			throw(std::runtime_error("Unknown metric"));
+		}
+	}
+
+	if(premapperNumBits <= MAX_DISTANCE_TABLE_BITS) {
+		return tableSearch(mapper, premapperNumBits, IntegerEuclidianDistance());
+	}
+
 	typedef TransformationAdaptor<LinearMapper> Transformation;
 	typedef SpinalBranchEvaluator<SpineValueType, Transformation, IntegerEuclidianDistance> BranchEval;
 	return ISymbolSearchFactoryPtr (
 		new SearchFactory<BranchEval>(
 			m_k,
 			m_spineLength,
-			BranchEval(Transformation(LinearMapper(premapperNumBits, precisionBits)),
-					   m_k)));
+			BranchEval(Transformation(mapper), m_k)));
 }
 
 
 template<typename SpineValueType>
 inline ISoftSearchFactoryPtr EncoderFactory<SpineValueType>::soft(
-		unsigned int premapperNumBits)
+		unsigned int premapperNumBits,
+		SpinalMetric metric)
 {
 	typedef TransformationAdaptor<SoftMapper> Transformation;
+
+	if(metric == METRIC_FLOAT) {
+		typedef SpinalBranchEvaluator<SpineValueType, Transformation, FloatEuclidianDistance<SoftSymbol> > BranchEval;
+		return ISoftSearchFactoryPtr (
+			new SearchFactory<BranchEval>(
+				m_k,
+				m_spineLength,
+				BranchEval(Transformation(SoftMapper(premapperNumBits)),
+						   m_k)));
+	} else if(metric != METRIC_DEFAULT) {
+		throw(std::runtime_error("Soft symbols only support default and float metrics"));
+	}
+
 	typedef SpinalBranchEvaluator<SpineValueType, Transformation, SoftEuclidianDistance> BranchEval;
 	return ISoftSearchFactoryPtr (
 		new SearchFactory<BranchEval>(
@@ -172,11 +314,16 @@ EncoderFactory<SpineValueType>::gaussian(
 		unsigned int precisionBits,
 		float numStandardDevs)
 {
-	typedef TransformationAdaptor<GaussianMapper> Transformation;
-	typedef SpinalBranchEvaluator<SpineValueType, Transformation, IntegerEuclidianDistance> BranchEval;
 	GaussianMapper mapper(premapperNumBits,
 						  precisionBits,
 						  numStandardDevs);
+
+	if(premapperNumBits <= MAX_DISTANCE_TABLE_BITS) {
+		return tableSearch(mapper, premapperNumBits, IntegerEuclidianDistance());
+	}
+
+	typedef TransformationAdaptor<GaussianMapper> Transformation;
+	typedef SpinalBranchEvaluator<SpineValueType, Transformation, IntegerEuclidianDistance> BranchEval;
 	return ISymbolSearchFactoryPtr (
 		new SearchFactory<BranchEval>(
 			m_k,
@@ -184,6 +331,22 @@ EncoderFactory<SpineValueType>::gaussian(
 			BranchEval(Transformation(mapper), m_k)));
 }
 
+template<typename SpineValueType>
+template<typename Mapper, typename Distance>
+inline ISymbolSearchFactoryPtr
+EncoderFactory<SpineValueType>::tableSearch(
+		const Mapper& mapper,
+		unsigned int premapperNumBits,
+		const Distance& distance)
+{
+	typedef TableBranchEvaluator<SpineValueType, Mapper, Distance> BranchEval;
+	return ISymbolSearchFactoryPtr (
+		new SearchFactory<BranchEval>(
+			m_k,
+			m_spineLength,
+			BranchEval(mapper, premapperNumBits, m_k, distance)));
+}
+
 template<typename SpineValueType>
 inline ISymbolSearchFactoryPtr
 EncoderFactory<SpineValueType>::bitwise(unsigned int numBits)
@@ -236,6 +399,36 @@ SearchFactory<BranchEvaluator>::beamDecoder(
 		unsigned int maxNumSymbolsPerValue,
 		unsigned int maxNumSymbolsLastValue)
 {
+	// Common configurations get a decoder specialized for their parameters
+	if((numLists == 1) && (m_k == 4)) {
+		switch(numBestPerList) {
+		case 64:
+			return fixedBeamDecoder<4, 64>(maxNumSymbolsPerValue,
+										   maxNumSymbolsLastValue);
+		case 256:
+			return fixedBeamDecoder<4, 256>(maxNumSymbolsPerValue,
+											maxNumSymbolsLastValue);
+		}
+	}
+
+	if(numLists == 1) {
+		// A single list is pruned by radix select, without keeping a heap
+		typedef BeamSearch<BranchEvaluator, RadixSelectBestK> Search;
+
+		typename Search::PrunerParams prunerParams(numBestPerList);
+
+		return IHashDecoderPtr (
+			new HashDecoder<Search> (
+				m_k,
+				m_spineLength,
+				maxNumSymbolsPerValue,
+				maxNumSymbolsLastValue,
+				Search(prunerParams,
+					   m_spineLength,
+					   m_branchEvaluator,
+					   m_k)));
+	}
+
 	typedef BeamSearch<BranchEvaluator, ParallelBestK> Search;
 	typedef typename BranchEvaluator::ChannelSymbol ChannelSymbol;
 
@@ -254,6 +447,31 @@ SearchFactory<BranchEvaluator>::beamDecoder(
 										m_k)));
 }
 
+template<typename BranchEvaluator>
+template<unsigned int K, unsigned int BEAM_WIDTH>
+inline typename SearchFactory<BranchEvaluator>::IHashDecoderPtr
+SearchFactory<BranchEvaluator>::fixedBeamDecoder(
+		unsigned int maxNumSymbolsPerValue,
+		unsigned int maxNumSymbolsLastValue)
+{
+	typedef typename BranchEvaluator::template WithFixedK<K> WithFixedK;
+	typedef typename WithFixedK::Type FixedEvaluator;
+	typedef BeamSearch<FixedEvaluator, RadixSelectBestK, K, BEAM_WIDTH> Search;
+
+	typename Search::PrunerParams prunerParams(BEAM_WIDTH);
+
+	return IHashDecoderPtr (
+		new HashDecoder<Search> (
+			m_k,
+			m_spineLength,
+			maxNumSymbolsPerValue,
+			maxNumSymbolsLastValue,
+			Search(prunerParams,
+				   m_spineLength,
+				   WithFixedK::convert(m_branchEvaluator),
+				   m_k)));
+}
+
 template<typename BranchEvaluator>
 inline typename SearchFactory<BranchEvaluator>::IHashDecoderPtr
 SearchFactory<BranchEvaluator>::lookaheadBeamDecoder(
@@ -276,3 +494,100 @@ SearchFactory<BranchEvaluator>::lookaheadBeamDecoder(
 												m_k,
 												lookaheadDepth)));
 }
+
+template<typename BranchEvaluator>
+inline typename SearchFactory<BranchEvaluator>::IHashDecoderPtr
+SearchFactory<BranchEvaluator>::soaBeamDecoder(
+		unsigned int numLists,
+		unsigned int numBestPerList,
+		unsigned int maxNumSymbolsPerValue,
+		unsigned int maxNumSymbolsLastValue)
+{
+	typedef BeamSearch<BranchEvaluator, ParallelBestK, 0, 0, SoADualPool> Search;
+
+	typename Search::PrunerParams prunerParams(numLists, numBestPerList);
+
+	return IHashDecoderPtr (
+		new HashDecoder<Search> (
+			m_k,
+			m_spineLength,
+			maxNumSymbolsPerValue,
+			maxNumSymbolsLastValue,
+			Search(prunerParams,
+				   m_spineLength,
+				   m_branchEvaluator,
+				   m_k)));
+}
+
+template<typename BranchEvaluator>
+inline typename SearchFactory<BranchEvaluator>::IHashDecoderPtr
+SearchFactory<BranchEvaluator>::threadedBeamDecoder(
+		unsigned int beamWidth,
+		unsigned int numThreads,
+		unsigned int maxNumSymbolsPerValue,
+		unsigned int maxNumSymbolsLastValue)
+{
+	typedef ThreadedBeamSearch<BranchEvaluator> Search;
+
+	return IHashDecoderPtr (
+		new HashDecoder<Search> (
+			m_k,
+			m_spineLength,
+			maxNumSymbolsPerValue,
+			maxNumSymbolsLastValue,
+			ThreadedBeamSearch<BranchEvaluator>(beamWidth,
+												numThreads,
+												m_spineLength,
+												m_branchEvaluator,
+												m_k)));
+}
+
+template<typename BranchEvaluator>
+inline typename SearchFactory<BranchEvaluator>::IHashDecoderPtr
+SearchFactory<BranchEvaluator>::stackDecoder(
+		unsigned int maxNumNodes,
+		double bias,
+		unsigned int maxNumSymbolsPerValue,
+		unsigned int maxNumSymbolsLastValue)
+{
+	typedef StackSearch<BranchEvaluator> Search;
+
+	return IHashDecoderPtr (
+		new HashDecoder<Search> (
+			m_k,
+			m_spineLength,
+			maxNumSymbolsPerValue,
+			maxNumSymbolsLastValue,
+			Search(maxNumNodes,
+				   bias,
+				   m_spineLength,
+				   m_branchEvaluator,
+				   m_k)));
+}
+
+template<typename BranchEvaluator>
+inline typename SearchFactory<BranchEvaluator>::IStreamingHashDecoderPtr
+SearchFactory<BranchEvaluator>::streamingDecoder(
+		unsigned int beamWidth,
+		unsigned int commitDistance,
+		unsigned int maxNumSymbolsPerValue,
+		unsigned int maxNumSymbolsLastValue)
+{
+	typedef BeamSearch<BranchEvaluator, RadixSelectBestK> Search;
+
+	typename Search::PrunerParams prunerParams(beamWidth);
+
+	// The search only keeps backtracking layers that were not committed
+	unsigned int searchDepth = std::min(commitDistance + 1, m_spineLength);
+
+	return IStreamingHashDecoderPtr (
+		new StreamingHashDecoder<Search> (
+			m_spineLength,
+			commitDistance,
+			maxNumSymbolsPerValue,
+			maxNumSymbolsLastValue,
+			Search(prunerParams,
+				   searchDepth,
+				   m_branchEvaluator,
+				   m_k)));
+}
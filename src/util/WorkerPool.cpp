@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2012 Jonathan Perry
+ * This code is released under the MIT license (see LICENSE file).
+ */
+#include "util/WorkerPool.h"
+
+#include <stdexcept>
+
+WorkerPool::WorkerPool(unsigned int numWorkers)
+  : m_numWorkers(numWorkers),
+    m_task(NULL),
+    m_generation(0),
+    m_numBusy(0),
+    m_shutdown(false)
+{
+	if(m_numWorkers == 0) {
+		throw(std::runtime_error("WorkerPool needs at least one worker"));
+	}
+
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_taskCond, NULL);
+	pthread_cond_init(&m_doneCond, NULL);
+
+	// Contexts must not move after threads get pointers to them
+	m_contexts.resize(m_numWorkers - 1);
+	m_threads.reserve(m_numWorkers - 1);
+
+	for(unsigned int i = 0; i < m_contexts.size(); i++) {
+		m_contexts[i].pool = this;
+		m_contexts[i].workerIndex = i + 1;
+
+		pthread_t thread;
+		if(pthread_create(&thread, NULL, &WorkerPool::threadMain, &m_contexts[i]) != 0) {
+			throw(std::runtime_error("Could not create worker thread"));
+		}
+		m_threads.push_back(thread);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	pthread_mutex_lock(&m_mutex);
+	m_shutdown = true;
+	pthread_cond_broadcast(&m_taskCond);
+	pthread_mutex_unlock(&m_mutex);
+
+	for(unsigned int i = 0; i < m_threads.size(); i++) {
+		pthread_join(m_threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&m_doneCond);
+	pthread_cond_destroy(&m_taskCond);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+unsigned int WorkerPool::size()
+{
+	return m_numWorkers;
+}
+
+void WorkerPool::run(IWorkerTask& task)
+{
+	if(m_threads.empty()) {
+		task.work(0);
+		return;
+	}
+
+	// Publish the task
+	pthread_mutex_lock(&m_mutex);
+	m_task = &task;
+	m_numBusy = m_threads.size();
+	m_generation++;
+	pthread_cond_broadcast(&m_taskCond);
+	pthread_mutex_unlock(&m_mutex);
+
+	// The calling thread is worker 0
+	task.work(0);
+
+	// Wait for the other workers
+	pthread_mutex_lock(&m_mutex);
+	while(m_numBusy > 0) {
+		pthread_cond_wait(&m_doneCond, &m_mutex);
+	}
+	m_task = NULL;
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void* WorkerPool::threadMain(void* context)
+{
+	ThreadContext* ctx = (ThreadContext*)context;
+	ctx->pool->serve(ctx->workerIndex);
+	return NULL;
+}
+
+void WorkerPool::serve(unsigned int workerIndex)
+{
+	unsigned int lastGeneration = 0;
+
+	pthread_mutex_lock(&m_mutex);
+	while(true) {
+		// Wait for a task we haven't run yet
+		while((!m_shutdown) && (m_generation == lastGeneration)) {
+			pthread_cond_wait(&m_taskCond, &m_mutex);
+		}
+		if(m_shutdown) {
+			break;
+		}
+		lastGeneration = m_generation;
+		IWorkerTask* task = m_task;
+		pthread_mutex_unlock(&m_mutex);
+
+		task->work(workerIndex);
+
+		pthread_mutex_lock(&m_mutex);
+		m_numBusy--;
+		if(m_numBusy == 0) {
+			pthread_cond_signal(&m_doneCond);
+		}
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
@@ -9,6 +9,7 @@ Public domain.
 */
 
 #include <string.h> // for memcpy
+#include <algorithm>
 #include <stdexcept>
 
 #include "ecrypt-portable.h"
@@ -123,3 +124,279 @@ int salsaGetSymbol(const SalsaState& state,
     unsigned int bits = (word >> shiftAmt) & ((1 << symbolSizeBits)-1);
     return ((int)bits);
 }
+
+
+/**************************
+ * Batch hashing
+ **************************/
+
+// The SIMD kernels need GCC-style target attributes and CPU detection
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || (__GNUC__ >= 5))
+#define SALSA_BATCH_X86
+#include <immintrin.h>
+#endif
+
+// The number of states computed together by the widest kernel
+#define SALSA_MAX_LANES 16
+
+/**
+ * Applies the salsa double rounds to 'x', an array of 16 vectors. The i'th
+ *    vector holds word i of several independent states. ADD, XOR and ROTL
+ *    operate on whole vectors.
+ */
+#define SALSA_DOUBLE_ROUNDS(x, ADD, XOR, ROTL) \
+	for (int round = 12; round > 0; round -= 2) { \
+		x[4] = XOR( x[4],ROTL(ADD( x[0],x[12]), 7)); \
+		x[8] = XOR( x[8],ROTL(ADD( x[4], x[0]), 9)); \
+		x[12] = XOR(x[12],ROTL(ADD( x[8], x[4]),13)); \
+		x[0] = XOR( x[0],ROTL(ADD(x[12], x[8]),18)); \
+		x[9] = XOR( x[9],ROTL(ADD( x[5], x[1]), 7)); \
+		x[13] = XOR(x[13],ROTL(ADD( x[9], x[5]), 9)); \
+		x[1] = XOR( x[1],ROTL(ADD(x[13], x[9]),13)); \
+		x[5] = XOR( x[5],ROTL(ADD( x[1],x[13]),18)); \
+		x[14] = XOR(x[14],ROTL(ADD(x[10], x[6]), 7)); \
+		x[2] = XOR( x[2],ROTL(ADD(x[14],x[10]), 9)); \
+		x[6] = XOR( x[6],ROTL(ADD( x[2],x[14]),13)); \
+		x[10] = XOR(x[10],ROTL(ADD( x[6], x[2]),18)); \
+		x[3] = XOR( x[3],ROTL(ADD(x[15],x[11]), 7)); \
+		x[7] = XOR( x[7],ROTL(ADD( x[3],x[15]), 9)); \
+		x[11] = XOR(x[11],ROTL(ADD( x[7], x[3]),13)); \
+		x[15] = XOR(x[15],ROTL(ADD(x[11], x[7]),18)); \
+		\
+		x[1] = XOR( x[1],ROTL(ADD( x[0], x[3]), 7)); \
+		x[2] = XOR( x[2],ROTL(ADD( x[1], x[0]), 9)); \
+		x[3] = XOR( x[3],ROTL(ADD( x[2], x[1]),13)); \
+		x[0] = XOR( x[0],ROTL(ADD( x[3], x[2]),18)); \
+		x[6] = XOR( x[6],ROTL(ADD( x[5], x[4]), 7)); \
+		x[7] = XOR( x[7],ROTL(ADD( x[6], x[5]), 9)); \
+		x[4] = XOR( x[4],ROTL(ADD( x[7], x[6]),13)); \
+		x[5] = XOR( x[5],ROTL(ADD( x[4], x[7]),18)); \
+		x[11] = XOR(x[11],ROTL(ADD(x[10], x[9]), 7)); \
+		x[8] = XOR( x[8],ROTL(ADD(x[11],x[10]), 9)); \
+		x[9] = XOR( x[9],ROTL(ADD( x[8],x[11]),13)); \
+		x[10] = XOR(x[10],ROTL(ADD( x[9], x[8]),18)); \
+		x[12] = XOR(x[12],ROTL(ADD(x[15],x[14]), 7)); \
+		x[13] = XOR(x[13],ROTL(ADD(x[12],x[15]), 9)); \
+		x[14] = XOR(x[14],ROTL(ADD(x[13],x[12]),13)); \
+		x[15] = XOR(x[15],ROTL(ADD(x[14],x[13]),18)); \
+	}
+
+/**
+ * Writes the initial states of up to 'numLanes' (digest, data) pairs into
+ *    'words', transposed: word i of lane j is written to words[i * numLanes + j].
+ *    Lanes past 'n' are zero.
+ */
+static void salsaLoadLanes(const SalsaDigest* digests,
+						   const u32* data,
+						   unsigned int n,
+						   unsigned int numLanes,
+						   u32* words)
+{
+	memset(words, 0, 16 * numLanes * sizeof(u32));
+
+	for(unsigned int lane = 0; lane < n; lane++) {
+		SalsaState state;
+		salsaInit(digests[lane], state);
+		state[6] ^= data[lane];
+		state[7] ^= data[lane];
+
+		for(unsigned int i = 0; i < 16; i++) {
+			words[i * numLanes + lane] = state[i];
+		}
+	}
+}
+
+/**
+ * Reverses salsaLoadLanes: copies the first 'n' lanes of the transposed
+ *    'words' into 'states'
+ */
+static void salsaStoreLanes(const u32* words,
+							unsigned int numLanes,
+							unsigned int n,
+							SalsaState* states)
+{
+	for(unsigned int lane = 0; lane < n; lane++) {
+		for(unsigned int i = 0; i < 16; i++) {
+			states[lane][i] = words[i * numLanes + lane];
+		}
+	}
+}
+
+static void salsaHashBatchScalar(const SalsaDigest* digests,
+								 const u32* data,
+								 unsigned int n,
+								 SalsaState* states)
+{
+	for(unsigned int i = 0; i < n; i++) {
+		salsaInit(digests[i], states[i]);
+		salsaUpdate(states[i], data[i]);
+	}
+}
+
+#ifdef SALSA_BATCH_X86
+
+#define SSE2_ADD(v,w) _mm_add_epi32((v),(w))
+#define SSE2_XOR(v,w) _mm_xor_si128((v),(w))
+#define SSE2_ROTL(v,c) \
+	_mm_or_si128(_mm_slli_epi32((v),(c)), _mm_srli_epi32((v),32-(c)))
+
+__attribute__((target("sse2")))
+static void salsaHashBatchSse2(const SalsaDigest* digests,
+							   const u32* data,
+							   unsigned int n,
+							   SalsaState* states)
+{
+	const unsigned int numLanes = 4;
+	u32 words[16 * numLanes];
+	__m128i x[16];
+	__m128i saved[16];
+
+	for(unsigned int first = 0; first < n; first += numLanes) {
+		unsigned int numValid = std::min(numLanes, n - first);
+		salsaLoadLanes(digests + first, data + first, numValid, numLanes, words);
+
+		for(int i = 0; i < 16; i++) {
+			x[i] = saved[i] = _mm_loadu_si128((const __m128i*)&words[i * numLanes]);
+		}
+
+		SALSA_DOUBLE_ROUNDS(x, SSE2_ADD, SSE2_XOR, SSE2_ROTL);
+
+		for(int i = 0; i < 16; i++) {
+			_mm_storeu_si128((__m128i*)&words[i * numLanes], SSE2_ADD(x[i], saved[i]));
+		}
+
+		salsaStoreLanes(words, numLanes, numValid, states + first);
+	}
+}
+
+#define AVX2_ADD(v,w) _mm256_add_epi32((v),(w))
+#define AVX2_XOR(v,w) _mm256_xor_si256((v),(w))
+#define AVX2_ROTL(v,c) \
+	_mm256_or_si256(_mm256_slli_epi32((v),(c)), _mm256_srli_epi32((v),32-(c)))
+
+__attribute__((target("avx2")))
+static void salsaHashBatchAvx2(const SalsaDigest* digests,
+							   const u32* data,
+							   unsigned int n,
+							   SalsaState* states)
+{
+	const unsigned int numLanes = 8;
+	u32 words[16 * numLanes];
+	__m256i x[16];
+	__m256i saved[16];
+
+	for(unsigned int first = 0; first < n; first += numLanes) {
+		unsigned int numValid = std::min(numLanes, n - first);
+		salsaLoadLanes(digests + first, data + first, numValid, numLanes, words);
+
+		for(int i = 0; i < 16; i++) {
+			x[i] = saved[i] = _mm256_loadu_si256((const __m256i*)&words[i * numLanes]);
+		}
+
+		SALSA_DOUBLE_ROUNDS(x, AVX2_ADD, AVX2_XOR, AVX2_ROTL);
+
+		for(int i = 0; i < 16; i++) {
+			_mm256_storeu_si256((__m256i*)&words[i * numLanes], AVX2_ADD(x[i], saved[i]));
+		}
+
+		salsaStoreLanes(words, numLanes, numValid, states + first);
+	}
+}
+
+#define AVX512_ADD(v,w) _mm512_add_epi32((v),(w))
+#define AVX512_XOR(v,w) _mm512_xor_si512((v),(w))
+#define AVX512_ROTL(v,c) _mm512_rol_epi32((v),(c))
+
+// Some GCC versions warn about uninitialized values inside the AVX-512
+// intrinsic headers themselves
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+static void salsaHashBatchAvx512(const SalsaDigest* digests,
+								 const u32* data,
+								 unsigned int n,
+								 SalsaState* states)
+{
+	const unsigned int numLanes = 16;
+	u32 words[16 * numLanes];
+	__m512i x[16];
+	__m512i saved[16];
+
+	for(unsigned int first = 0; first < n; first += numLanes) {
+		unsigned int numValid = std::min(numLanes, n - first);
+		salsaLoadLanes(digests + first, data + first, numValid, numLanes, words);
+
+		for(int i = 0; i < 16; i++) {
+			x[i] = saved[i] = _mm512_loadu_si512((const void*)&words[i * numLanes]);
+		}
+
+		SALSA_DOUBLE_ROUNDS(x, AVX512_ADD, AVX512_XOR, AVX512_ROTL);
+
+		for(int i = 0; i < 16; i++) {
+			_mm512_storeu_si512((void*)&words[i * numLanes], AVX512_ADD(x[i], saved[i]));
+		}
+
+		salsaStoreLanes(words, numLanes, numValid, states + first);
+	}
+}
+
+#pragma GCC diagnostic pop
+
+#endif // SALSA_BATCH_X86
+
+typedef void (*SalsaBatchKernel)(const SalsaDigest*,
+								 const u32*,
+								 unsigned int,
+								 SalsaState*);
+
+struct SalsaBatchImplementation {
+	SalsaBatchKernel kernel;
+	const char* name;
+};
+
+/**
+ * Chooses the widest kernel the CPU supports
+ */
+static SalsaBatchImplementation salsaSelectBatchImplementation()
+{
+	SalsaBatchImplementation impl;
+	impl.kernel = &salsaHashBatchScalar;
+	impl.name = "scalar";
+
+#ifdef SALSA_BATCH_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")) {
+		impl.kernel = &salsaHashBatchAvx512;
+		impl.name = "avx512";
+	} else if(__builtin_cpu_supports("avx2")) {
+		impl.kernel = &salsaHashBatchAvx2;
+		impl.name = "avx2";
+	} else if(__builtin_cpu_supports("sse2")) {
+		impl.kernel = &salsaHashBatchSse2;
+		impl.name = "sse2";
+	}
+#endif
+
+	return impl;
+}
+
+static const SalsaBatchImplementation& salsaBatchImplementation()
+{
+	static const SalsaBatchImplementation impl = salsaSelectBatchImplementation();
+	return impl;
+}
+
+void salsaHashBatch(const SalsaDigest* digests,
+					const u32* data,
+					unsigned int n,
+					SalsaState* states)
+{
+	salsaBatchImplementation().kernel(digests, data, n, states);
+}
+
+const char* salsaBatchImplementationName()
+{
+	return salsaBatchImplementation().name;
+}